@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "logo.hpp"
+#include "png.hpp"
+#include "synthetic.hpp"
+
+struct Args
+{
+    bool json {false};
+    unsigned int min_iterations {3};
+    double min_time {0.25};
+    std::vector<std::string> resolutions;
+    std::vector<std::string> profiles;
+};
+
+std::optional<Args> get_args(int argc, char * argv[])
+{
+    cxxopts::Options options{argv[0], "Measure motologo encode / decode throughput on synthetic images"};
+
+    try
+    {
+        options.add_options()
+            ("h,help",       "Show this message and quit")
+            ("json",         "Output results as JSON")
+            ("i,iterations", "Minimum number of times to run each test", cxxopts::value<unsigned int>()->default_value("3"), "N")
+            ("t,min-time",   "Minimum time to spend on each test, in seconds", cxxopts::value<double>()->default_value("0.25"), "SECONDS")
+            ("resolution",   "Only test these resolutions (720p, 1080p, 1440p)", cxxopts::value<std::vector<std::string>>(), "NAME[,NAME...]")
+            ("profile",      "Only test these run length profiles (flat, text, gradient, noise)", cxxopts::value<std::vector<std::string>>(), "NAME[,NAME...]");
+
+        auto args = options.parse(argc, argv);
+
+        if(args.count("help"))
+        {
+            std::cerr<<options.help()<<'\n';
+            return {};
+        }
+
+        Args output_args;
+        output_args.json = args.count("json");
+        output_args.min_iterations = std::max(args["iterations"].as<unsigned int>(), 1u);
+        output_args.min_time = args["min-time"].as<double>();
+        if(args.count("resolution"))
+            output_args.resolutions = args["resolution"].as<std::vector<std::string>>();
+        if(args.count("profile"))
+            output_args.profiles = args["profile"].as<std::vector<std::string>>();
+
+        return output_args;
+    }
+    catch(const cxxopts::OptionException & e)
+    {
+        std::cerr<<options.help()<<'\n'<<e.what()<<'\n';
+        return {};
+    }
+}
+
+struct Result
+{
+    std::string phase;
+    std::string resolution;
+    std::string profile;
+    std::size_t iterations {0};
+    double seconds {0.0};           // per iteration
+    std::size_t raw_bytes {0};      // uncompressed RGB bytes processed per iteration
+    std::size_t pixels {0};         // pixels processed per iteration
+    std::size_t compressed_bytes {0};
+
+    double mb_per_sec() const { return raw_bytes / seconds / 1e6; }
+    double mpixels_per_sec() const { return pixels / seconds / 1e6; }
+};
+
+// run func until both the minimum number of iterations and time have passed, and return the mean time per call
+std::pair<double, std::size_t> time_it(const Args & args, const std::function<void()> & func)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::size_t iterations = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{0};
+    do
+    {
+        func();
+        ++iterations;
+        elapsed = clock::now() - start;
+    } while(iterations < args.min_iterations || elapsed.count() < args.min_time);
+
+    return {elapsed.count() / iterations, iterations};
+}
+
+bool selected(const std::vector<std::string> & filter, const std::string & name)
+{
+    return std::empty(filter) || std::find(std::begin(filter), std::end(filter), name) != std::end(filter);
+}
+
+void print_result(const Result & result)
+{
+    std::cout<<std::left<<std::setw(18)<<result.phase
+        <<std::setw(7)<<result.resolution
+        <<std::setw(10)<<result.profile
+        <<std::right<<std::fixed<<std::setprecision(1)
+        <<std::setw(10)<<result.mb_per_sec()<<" MB/s"
+        <<std::setw(10)<<result.mpixels_per_sec()<<" Mpx/s"
+        <<std::setw(8)<<result.iterations<<" iter";
+    if(result.compressed_bytes)
+        std::cout<<std::setw(12)<<result.compressed_bytes<<" bytes";
+    std::cout<<'\n';
+}
+
+void print_json(const std::vector<Result> & results)
+{
+    std::cout<<"[\n";
+    for(auto i = 0u; i < std::size(results); ++i)
+    {
+        auto && r = results[i];
+        std::cout<<"  {\"phase\": \""<<r.phase<<"\", \"resolution\": \""<<r.resolution<<"\", \"profile\": \""<<r.profile<<"\""
+            <<", \"iterations\": "<<r.iterations
+            <<", \"seconds\": "<<std::scientific<<std::setprecision(6)<<r.seconds
+            <<", \"raw_bytes\": "<<r.raw_bytes
+            <<", \"pixels\": "<<r.pixels
+            <<", \"compressed_bytes\": "<<r.compressed_bytes
+            <<", \"mb_per_sec\": "<<std::fixed<<std::setprecision(3)<<r.mb_per_sec()
+            <<", \"mpixels_per_sec\": "<<r.mpixels_per_sec()
+            <<"}"<<(i + 1 < std::size(results) ? "," : "")<<'\n';
+    }
+    std::cout<<"]\n";
+}
+
+int main(int argc, char * argv[])
+{
+    auto args = get_args(argc, argv);
+    if(!args)
+        return EXIT_FAILURE;
+
+    try
+    {
+        auto tmp_dir = std::filesystem::temp_directory_path() / "motologo_bench";
+        std::filesystem::create_directories(tmp_dir);
+
+        std::vector<Result> results;
+        auto add_result = [&args, &results](Result && result)
+        {
+            if(!args->json)
+                print_result(result);
+            results.push_back(std::move(result));
+        };
+
+        for(auto && resolution: synthetic_resolutions())
+        {
+            if(!selected(args->resolutions, resolution.name))
+                continue;
+
+            std::vector<Logo_image> logo_images;
+            std::size_t logo_pixels = 0;
+
+            for(auto && profile: synthetic_profiles())
+            {
+                if(!selected(args->profiles, profile.name))
+                    continue;
+
+                Synthetic_params params;
+                params.width = resolution.width;
+                params.height = resolution.height;
+                params.mean_run = profile.mean_run;
+                params.noise = profile.noise;
+                params.palette = profile.palette;
+
+                auto im = make_synthetic_image(params);
+                im.name = (tmp_dir / (profile.name + "_" + resolution.name + ".png")).string();
+
+                const auto pixels = im.width * im.height;
+                const auto raw_bytes = std::size(im.image_data);
+
+                auto run = [&](const std::string & phase, const std::function<void()> & func, std::size_t compressed_bytes = 0)
+                {
+                    auto [seconds, iterations] = time_it(*args, func);
+                    add_result({phase, resolution.name, profile.name, iterations, seconds, raw_bytes, pixels, compressed_bytes});
+                };
+
+                std::vector<std::byte> blob;
+                run("encode", [&]{ blob = encode_image(im); }, std::size(blob = encode_image(im)));
+
+                std::vector<std::byte> optimal_blob;
+                run("encode_optimal", [&]{ optimal_blob = encode_image(im, Rle_mode::optimal); }, std::size(optimal_blob = encode_image(im, Rle_mode::optimal)));
+
+                run("decode", [&]{ read_image_data(blob, profile.name, "bench"); }, std::size(blob));
+                run("decode_reference", [&]{ read_image_data_reference(blob, profile.name, "bench"); }, std::size(blob));
+
+                Png_options fast_png;
+                parse_png_level("fast", fast_png);
+                write_png(im, fast_png);
+                run("write_png_fast", [&]{ write_png(im, fast_png); }, std::filesystem::file_size(im.name));
+
+                write_png(im);
+                run("write_png", [&]{ write_png(im); }, std::filesystem::file_size(im.name));
+                run("read_png", [&]{ read_png(im.name); }, std::filesystem::file_size(im.name));
+                std::filesystem::remove(im.name);
+
+                logo_images.push_back({profile.name, std::move(blob)});
+                logo_pixels += pixels;
+            }
+
+            if(std::empty(logo_images))
+                continue;
+
+            // whole file, with one entry for each profile
+            std::vector<Image> decoded;
+            for(auto && image: logo_images)
+                decoded.push_back(read_image_data(image.data, image.name, "bench"));
+
+            auto logo = build_logo(logo_images);
+
+            auto pack = [&]
+            {
+                std::vector<Logo_image> packed;
+                for(auto && im: decoded)
+                    packed.push_back({im.name, encode_image(im)});
+                logo = build_logo(packed);
+            };
+            auto unpack = [&]
+            {
+                for(auto && entry: parse_directory(logo, "bench"))
+                    decode_image(logo, entry, "bench");
+            };
+
+            auto [pack_seconds, pack_iterations] = time_it(*args, pack);
+            add_result({"pack", resolution.name, "all", pack_iterations, pack_seconds, logo_pixels * 3, logo_pixels, std::size(logo)});
+
+            auto [unpack_seconds, unpack_iterations] = time_it(*args, unpack);
+            add_result({"unpack", resolution.name, "all", unpack_iterations, unpack_seconds, logo_pixels * 3, logo_pixels, std::size(logo)});
+        }
+
+        std::filesystem::remove_all(tmp_dir);
+
+        if(args->json)
+            print_json(results);
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
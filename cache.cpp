@@ -0,0 +1,117 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+#include "hash.hpp"
+#include "logo.hpp"
+#include "readb.hpp"
+
+Blob_cache::Blob_cache(const std::filesystem::path & dir): dir_{dir}
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if(ec)
+        throw std::runtime_error{"Could not create cache directory: " + dir_.string() + ". " + ec.message()};
+}
+
+std::string Blob_cache::key(const Image & im, std::string_view variant) const
+{
+    auto pixels = std::as_bytes(std::span{im.image_data});
+
+    // keys are of the packed pixels, so row padding doesn't change them
+    std::vector<std::uint8_t> packed;
+    if(!im.packed())
+    {
+        packed.resize(im.width * im.height * 3);
+        for(std::size_t y = 0; y < im.height; ++y)
+            std::copy_n(im.row(y), im.width * 3, std::data(packed) + y * im.width * 3);
+        pixels = std::as_bytes(std::span{packed});
+    }
+
+    // two independently seeded hashes, so a collision is vanishingly unlikely
+    auto key = hash_to_string(hash_bytes(pixels, 0)) + hash_to_string(hash_bytes(pixels, 1))
+        + "-" + std::to_string(im.width) + "x" + std::to_string(im.height);
+
+    if(!std::empty(variant))
+    {
+        key += '-';
+        key += variant;
+    }
+
+    return key;
+}
+
+std::optional<std::vector<std::byte>> Blob_cache::find(const std::string & key, const Image & im)
+{
+    auto path = dir_ / (key + ".motorun");
+
+    std::error_code ec;
+    if(!std::filesystem::is_regular_file(path, ec))
+    {
+        ++misses_;
+        return {};
+    }
+
+    auto blob = read_file(path.string());
+
+    // make sure it's a complete MotoRun image of the right size, in case the file was damaged.
+    // Every packet is walked, and they have to cover exactly every pixel and the whole file. Anything else is a miss,
+    // and gets re-encoded and stored over the damaged entry
+    try
+    {
+        auto header = read_image_header(blob, key, path.string());
+        auto stats = rle_stats(blob, key, path.string());
+
+        constexpr auto header_size = 8u + 2u * sizeof(std::uint16_t); // identifier, width and height
+        const auto packets = stats.repeat_packets + stats.literal_packets;
+        const auto packet_bytes = packets * 2 + stats.repeat_packets * 3 + stats.literal_pixels * 3;
+
+        if(header.width != im.width || header.height != im.height
+            || stats.repeat_pixels + stats.literal_pixels != static_cast<std::uint64_t>(im.width) * im.height
+            || std::size(blob) != header_size + packet_bytes)
+        {
+            ++misses_;
+            return {};
+        }
+    }
+    catch(const std::runtime_error &)
+    {
+        ++misses_;
+        return {};
+    }
+
+    ++hits_;
+    return blob;
+}
+
+void Blob_cache::store(const std::string & key, std::span<const std::byte> blob) const
+{
+    auto path = dir_ / (key + ".motorun");
+
+    // write to a temp file and rename it into place, so other readers never see a partial file
+    auto tmp_path = path;
+    tmp_path += '.';
+    tmp_path += std::to_string(std::random_device{}());
+    tmp_path += ".tmp";
+
+    {
+        std::ofstream file{tmp_path, std::ios::binary};
+        file.write(reinterpret_cast<const char *>(std::data(blob)), std::size(blob));
+        if(!file)
+        {
+            std::error_code ec;
+            std::filesystem::remove(tmp_path, ec);
+            return;
+        }
+    }
+
+    // a cache that can't be written to just means more misses later
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if(ec)
+        std::filesystem::remove(tmp_path, ec);
+}
@@ -0,0 +1,39 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <atomic>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstddef>
+
+#include "image.hpp"
+
+// on-disk cache of compressed MotoRun images, keyed by a hash of the uncompressed pixels and dimensions.
+// Safe to share between threads and between processes
+class Blob_cache
+{
+public:
+    explicit Blob_cache(const std::filesystem::path & dir);
+
+    // cache key for an image. variant distinguishes different encodings of the same pixels
+    std::string key(const Image & im, std::string_view variant = {}) const;
+
+    // look up a compressed image. Counts a hit or miss
+    std::optional<std::vector<std::byte>> find(const std::string & key, const Image & im);
+    void store(const std::string & key, std::span<const std::byte> blob) const;
+
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+
+private:
+    std::filesystem::path dir_;
+    std::atomic<std::size_t> hits_ {0};
+    std::atomic<std::size_t> misses_ {0};
+};
+
+#endif // CACHE_HPP
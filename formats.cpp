@@ -0,0 +1,387 @@
+#include "formats.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "mapped_file.hpp"
+#include "readb.hpp"
+#include "simd.hpp"
+
+Image_format parse_image_format(const std::string & name)
+{
+    if(name == "png")
+        return Image_format::png;
+    else if(name == "ppm")
+        return Image_format::ppm;
+    else if(name == "bmp")
+        return Image_format::bmp;
+    else if(name == "raw" || name == "rgb")
+        return Image_format::raw;
+    else
+        throw std::runtime_error{"Unknown image format: " + name};
+}
+
+std::optional<Image_format> format_from_extension(const std::string & filename)
+{
+    auto ext_start = filename.find_last_of('.');
+    if(ext_start == std::string::npos || filename.find_first_of("/\\", ext_start) != std::string::npos)
+        return {};
+
+    auto ext = filename.substr(ext_start + 1);
+    std::transform(std::begin(ext), std::end(ext), std::begin(ext), [](unsigned char c) { return std::tolower(c); });
+
+    try
+    {
+        return parse_image_format(ext);
+    }
+    catch(const std::runtime_error &)
+    {
+        return {};
+    }
+}
+
+std::pair<std::size_t, std::size_t> parse_image_size(const std::string & size)
+{
+    auto parse = [&size](const std::string & dimension)
+    {
+        if(std::empty(dimension) || std::size(dimension) > 5
+            || !std::all_of(std::begin(dimension), std::end(dimension), [](unsigned char c) { return std::isdigit(c); }))
+            throw std::runtime_error{"Invalid size: " + size};
+
+        auto value = std::stoul(dimension);
+        if(value == 0 || value > max_image_dimension)
+            throw std::runtime_error{"Invalid size: " + size + ". Each dimension must be from 1 to " + std::to_string(max_image_dimension)};
+
+        return static_cast<std::size_t>(value);
+    };
+
+    auto x = size.find('x');
+    if(x == std::string::npos)
+        throw std::runtime_error{"Invalid size: " + size};
+
+    return {parse(size.substr(0, x)), parse(size.substr(x + 1))};
+}
+
+std::string format_extension(Image_format format)
+{
+    switch(format)
+    {
+    case Image_format::png: return ".png";
+    case Image_format::ppm: return ".ppm";
+    case Image_format::bmp: return ".bmp";
+    case Image_format::raw: return ".rgb";
+    }
+    throw std::logic_error{"Unhandled image format"};
+}
+
+namespace
+{
+    constexpr auto bmp_file_header_size = 14u;
+    constexpr auto bmp_info_header_size = 40u;
+
+    std::size_t bmp_row_size(std::size_t width, std::size_t bits_per_pixel)
+    {
+        return (width * bits_per_pixel + 31) / 32 * 4;
+    }
+
+    // checked before any size is calculated from the dimensions, so nothing can overflow
+    void check_dimensions(const std::string & filename, std::size_t width, std::size_t height)
+    {
+        if(width > max_image_dimension || height > max_image_dimension)
+            throw std::runtime_error{"Error reading " + filename + ": image dimensions are too large (" + std::to_string(width) + "x" + std::to_string(height)
+                + "). The limit is " + std::to_string(max_image_dimension) + "x" + std::to_string(max_image_dimension)};
+    }
+
+    // copy packed RGB rows into an image, which may have padded rows
+    void copy_packed_rows(const std::byte * src, Image & img)
+    {
+        if(img.packed())
+        {
+            std::memcpy(std::data(img.image_data), src, std::size(img.image_data));
+            return;
+        }
+
+        for(std::size_t row = 0; row < img.height; ++row, src += img.width * 3)
+            std::memcpy(img.row(row), src, img.width * 3);
+    }
+
+    Image read_ppm(const std::string & filename, std::span<const std::byte> data, std::size_t row_alignment)
+    {
+        if(Byte_reader{data}.read_str(2) != "P6")
+            throw std::runtime_error{"Error reading " + filename + ": not a binary PPM file"};
+
+        // the rest of the header is text
+        auto input = std::begin(data) + 2;
+
+        // header fields are separated by whitespace, and may have comments between them
+        auto read_field = [&]()
+        {
+            while(true)
+            {
+                if(input == std::end(data))
+                    throw std::runtime_error{"Error reading " + filename + ": unexpected end of PPM header"};
+
+                auto c = static_cast<char>(*input);
+                if(c == '#')
+                {
+                    while(input != std::end(data) && static_cast<char>(*input) != '\n')
+                        ++input;
+                }
+                else if(std::isspace(static_cast<unsigned char>(c)))
+                    ++input;
+                else
+                    break;
+            }
+
+            std::size_t value = 0;
+            auto digits = 0u;
+            for(; input != std::end(data) && std::isdigit(static_cast<unsigned char>(*input)); ++input, ++digits)
+            {
+                value = value * 10 + (static_cast<char>(*input) - '0');
+                if(value > std::numeric_limits<std::uint32_t>::max())
+                    throw std::runtime_error{"Error reading " + filename + ": bad PPM header"};
+            }
+
+            if(digits == 0)
+                throw std::runtime_error{"Error reading " + filename + ": bad PPM header"};
+
+            return value;
+        };
+
+        auto width = read_field();
+        auto height = read_field();
+        auto max_value = read_field();
+
+        if(max_value != 255)
+            throw std::runtime_error{"Error reading " + filename + ": only 8 bit PPM files are supported"};
+
+        check_dimensions(filename, width, height);
+
+        // exactly one whitespace character before the pixel data
+        if(input == std::end(data) || !std::isspace(static_cast<unsigned char>(*input)))
+            throw std::runtime_error{"Error reading " + filename + ": bad PPM header"};
+        ++input;
+
+        if(static_cast<std::size_t>(std::end(data) - input) < width * height * 3)
+            throw std::runtime_error{"Error reading " + filename + ": unexpected end of PPM data"};
+
+        Image img{width, height, row_alignment};
+        copy_packed_rows(std::to_address(input), img);
+
+        return img;
+    }
+
+    Image read_bmp(const std::string & filename, std::span<const std::byte> data, std::size_t row_alignment)
+    {
+        auto input = Byte_reader{data};
+
+        if(input.read_str(2) != "BM")
+            throw std::runtime_error{"Error reading " + filename + ": not a BMP file"};
+
+        if(std::size(data) < bmp_file_header_size + bmp_info_header_size)
+            throw std::runtime_error{"Error reading " + filename + ": bad BMP header"};
+
+        input.seek(10);
+        auto pixel_offset = input.read<std::uint32_t>(std::endian::little);
+        auto info_size = input.read<std::uint32_t>(std::endian::little);
+        auto width = input.read<std::int32_t>(std::endian::little);
+        auto height = input.read<std::int32_t>(std::endian::little);
+        input.skip(sizeof(std::uint16_t)); // planes
+        auto bits_per_pixel = input.read<std::uint16_t>(std::endian::little);
+        auto compression = input.read<std::uint32_t>(std::endian::little);
+
+        if(info_size < bmp_info_header_size || width < 0 || height == std::numeric_limits<std::int32_t>::min())
+            throw std::runtime_error{"Error reading " + filename + ": bad BMP header"};
+
+        // 0: BI_RGB, uncompressed
+        if((bits_per_pixel != 24 && bits_per_pixel != 32) || compression != 0)
+            throw std::runtime_error{"Error reading " + filename + ": only uncompressed 24 and 32 bit BMP files are supported"};
+
+        // rows are stored bottom-up, unless the height is negative
+        auto top_down = height < 0;
+        auto abs_height = static_cast<std::size_t>(top_down ? -height : height);
+        check_dimensions(filename, width, abs_height);
+
+        const auto bytes_per_pixel = bits_per_pixel / 8u;
+        const auto row_size = bmp_row_size(width, bits_per_pixel);
+
+        if(pixel_offset > std::size(data) || row_size * abs_height > std::size(data) - pixel_offset)
+            throw std::runtime_error{"Error reading " + filename + ": unexpected end of BMP data"};
+
+        Image img{static_cast<std::size_t>(width), abs_height, row_alignment};
+
+        for(std::size_t row = 0; row < abs_height; ++row)
+        {
+            auto src = reinterpret_cast<const std::uint8_t *>(std::data(data)) + pixel_offset + (top_down ? row : abs_height - row - 1) * row_size;
+            auto dst = img.row(row);
+
+            if(bytes_per_pixel == 3)
+                bgr_to_rgb(src, dst, img.width);
+            else
+            {
+                for(std::size_t col = 0; col < img.width; ++col, src += 4, dst += 3)
+                {
+                    dst[0] = src[2];
+                    dst[1] = src[1];
+                    dst[2] = src[0];
+                }
+            }
+        }
+
+        return img;
+    }
+
+    Image read_raw(const std::string & filename, std::span<const std::byte> data, std::size_t width, std::size_t height, std::size_t row_alignment)
+    {
+        if(width == 0 || height == 0)
+            throw std::runtime_error{"Error reading " + filename + ": the size of raw images has to be given"};
+        check_dimensions(filename, width, height);
+
+        if(std::size(data) != width * height * 3)
+            throw std::runtime_error{"Error reading " + filename + ": raw file is " + std::to_string(std::size(data)) + " bytes, expected "
+                + std::to_string(width * height * 3) + " for " + std::to_string(width) + "x" + std::to_string(height)};
+
+        Image img{width, height, row_alignment};
+        copy_packed_rows(std::data(data), img);
+
+        return img;
+    }
+
+    // shared by the uncompressed formats
+    class File_row_writer: public Row_writer
+    {
+    public:
+        explicit File_row_writer(const std::string & filename): filename_{filename}, file_{filename, std::ios::binary}
+        {
+            if(!file_)
+                throw std::runtime_error{"Could not open output file: " + filename + ". " + std::strerror(errno)};
+        }
+
+        void finish() override
+        {
+            file_.close();
+            if(!file_)
+                throw std::runtime_error{"Error writing " + filename_ + ". " + std::strerror(errno)};
+        }
+
+    protected:
+        void write(const void * data, std::size_t size)
+        {
+            file_.write(static_cast<const char *>(data), size);
+            if(!file_)
+                throw std::runtime_error{"Error writing " + filename_ + ". " + std::strerror(errno)};
+        }
+
+    private:
+        std::string filename_;
+        std::ofstream file_;
+    };
+
+    class Raw_writer: public File_row_writer
+    {
+    public:
+        Raw_writer(const std::string & filename, std::size_t width): File_row_writer{filename}, width_{width} {}
+
+        void write_row(const std::uint8_t * row) override
+        {
+            write(row, width_ * 3);
+        }
+
+    private:
+        std::size_t width_;
+    };
+
+    class Ppm_writer: public Raw_writer
+    {
+    public:
+        Ppm_writer(const std::string & filename, std::size_t width, std::size_t height): Raw_writer{filename, width}
+        {
+            auto header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+            write(std::data(header), std::size(header));
+        }
+    };
+
+    class Bmp_writer: public File_row_writer
+    {
+    public:
+        Bmp_writer(const std::string & filename, std::size_t width, std::size_t height):
+            File_row_writer{filename},
+            width_{width},
+            row_(bmp_row_size(width, 24), 0)
+        {
+            const auto image_size = std::size(row_) * height;
+            if(width > std::numeric_limits<std::int32_t>::max() || height > std::numeric_limits<std::int32_t>::max()
+                || image_size > std::numeric_limits<std::uint32_t>::max() - bmp_file_header_size - bmp_info_header_size)
+                throw std::runtime_error{"Error writing " + filename + ": image is too large for BMP"};
+
+            std::vector<std::byte> header(bmp_file_header_size + bmp_info_header_size);
+            auto output = Byte_writer{header};
+
+            output.write_str("BM", 2);
+            output.write(static_cast<std::uint32_t>(bmp_file_header_size + bmp_info_header_size + image_size), std::endian::little);
+            output.write(std::uint32_t{0}, std::endian::little); // reserved
+            output.write(std::uint32_t{bmp_file_header_size + bmp_info_header_size}, std::endian::little);
+
+            output.write(std::uint32_t{bmp_info_header_size}, std::endian::little);
+            output.write(static_cast<std::int32_t>(width), std::endian::little);
+            output.write(-static_cast<std::int32_t>(height), std::endian::little); // negative: rows are top-down, same order we get them in
+            output.write(std::uint16_t{1}, std::endian::little); // planes
+            output.write(std::uint16_t{24}, std::endian::little); // bits per pixel
+            output.write(std::uint32_t{0}, std::endian::little); // BI_RGB
+            output.write(static_cast<std::uint32_t>(image_size), std::endian::little);
+            output.write(std::int32_t{2835}, std::endian::little); // 72 DPI
+            output.write(std::int32_t{2835}, std::endian::little);
+            output.write(std::uint32_t{0}, std::endian::little); // palette size
+            output.write(std::uint32_t{0}, std::endian::little); // important colors
+
+            write(std::data(header), std::size(header));
+        }
+
+        void write_row(const std::uint8_t * row) override
+        {
+            bgr_to_rgb(row, std::data(row_), width_); // swapping works both ways
+            write(std::data(row_), std::size(row_));
+        }
+
+    private:
+        std::size_t width_;
+        std::vector<std::uint8_t> row_;
+    };
+}
+
+Image read_image(const std::string & filename, Image_format format, std::size_t raw_width, std::size_t raw_height, std::size_t row_alignment)
+{
+    if(format == Image_format::png)
+        return read_png(filename, row_alignment);
+
+    auto file = Mapped_file{filename};
+
+    switch(format)
+    {
+    case Image_format::ppm: return read_ppm(filename, file.data(), row_alignment);
+    case Image_format::bmp: return read_bmp(filename, file.data(), row_alignment);
+    case Image_format::raw: return read_raw(filename, file.data(), raw_width, raw_height, row_alignment);
+    default: break;
+    }
+    throw std::logic_error{"Unhandled image format"};
+}
+
+std::unique_ptr<Row_writer> make_row_writer(const std::string & filename, std::size_t width, std::size_t height, Image_format format, const Png_options & png_options)
+{
+    switch(format)
+    {
+    case Image_format::png: return std::make_unique<Png_writer>(filename, width, height, png_options);
+    case Image_format::ppm: return std::make_unique<Ppm_writer>(filename, width, height);
+    case Image_format::bmp: return std::make_unique<Bmp_writer>(filename, width, height);
+    case Image_format::raw: return std::make_unique<Raw_writer>(filename, width);
+    }
+    throw std::logic_error{"Unhandled image format"};
+}
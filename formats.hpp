@@ -0,0 +1,39 @@
+#ifndef FORMATS_HPP
+#define FORMATS_HPP
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <cstddef>
+
+#include "image.hpp"
+#include "png.hpp"
+
+// image file formats that can be converted to and from logo.bin images.
+// Everything but PNG is uncompressed, so they're much faster to read and write
+enum class Image_format
+{
+    png,
+    ppm, // binary (P6) PPM
+    bmp, // 24 bit uncompressed BMP. 32 bit is also accepted for input
+    raw  // packed RGB, with no header. The size has to be given separately
+};
+
+// parse a format name: png, ppm, bmp, or raw
+Image_format parse_image_format(const std::string & name);
+// guess the format from a filename's extension (.png, .ppm, .bmp, .rgb or .raw)
+std::optional<Image_format> format_from_extension(const std::string & filename);
+// file extension for a format, including the '.'
+std::string format_extension(Image_format format);
+// parse dimensions given as WIDTHxHEIGHT. Each must be from 1 to max_image_dimension
+std::pair<std::size_t, std::size_t> parse_image_size(const std::string & size);
+
+// load an image. Throws if either dimension is larger than max_image_dimension. raw_width and raw_height are only used for raw files. See Image::set_size for row_alignment
+Image read_image(const std::string & filename, Image_format format, std::size_t raw_width = 0, std::size_t raw_height = 0, std::size_t row_alignment = 0);
+
+// open an image file for writing one row at a time. png_options are only used for PNG files
+std::unique_ptr<Row_writer> make_row_writer(const std::string & filename, std::size_t width, std::size_t height, Image_format format, const Png_options & png_options = {});
+
+#endif // FORMATS_HPP
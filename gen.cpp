@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "formats.hpp"
+#include "logo.hpp"
+#include "mapped_file.hpp"
+#include "synthetic.hpp"
+
+struct Args
+{
+    std::string output_filename;
+    unsigned int num_files {1};
+    unsigned int num_entries {4};
+    Synthetic_params params;
+
+    std::vector<std::string> roundtrip_filenames;
+};
+
+std::optional<Args> get_args(int argc, char * argv[])
+{
+    cxxopts::Options options{argv[0], "Generate synthetic Moto logo.bin files, or check that logo.bin files survive an unpack / repack unchanged"};
+
+    try
+    {
+        options.add_options()
+            ("h,help",      "Show this message and quit")
+            ("o,output",    "Output filename. Default filename is logo.bin. With --files, a number is added to each name", cxxopts::value<std::string>()->default_value("logo.bin"), "OUTPUT")
+            ("files",       "Number of files to generate, each with a different seed", cxxopts::value<unsigned int>()->default_value("1"), "N")
+            ("n,entries",   "Number of images in each file", cxxopts::value<unsigned int>()->default_value("4"), "N")
+            ("size",        "Image dimensions", cxxopts::value<std::string>()->default_value("720x1280"), "WIDTHxHEIGHT")
+            ("profile",     "Run length profile: flat, text, gradient, or noise. Sets --mean-run, --noise, and --palette", cxxopts::value<std::string>(), "NAME")
+            ("mean-run",    "Average length of a run of one color, in pixels", cxxopts::value<double>()->default_value("64"), "PIXELS")
+            ("noise",       "Chance of a pixel being a random color, 0 - 1", cxxopts::value<double>()->default_value("0"), "AMOUNT")
+            ("palette",     "Number of distinct run colors", cxxopts::value<unsigned int>()->default_value("8"), "N")
+            ("seed",        "Random seed", cxxopts::value<std::uint32_t>()->default_value("1"), "SEED")
+            ("roundtrip",   "Instead of generating, decode and re-encode the given logo.bin files, and check that the result is identical", cxxopts::value<std::vector<std::string>>(), "LOGO.BIN");
+
+        options.parse_positional({"roundtrip"});
+        options.positional_help("[LOGO.BIN ...]");
+
+        auto args = options.parse(argc, argv);
+
+        if(args.count("help"))
+        {
+            std::cerr<<options.help()<<'\n';
+            return {};
+        }
+
+        Args output_args;
+        output_args.output_filename = args["output"].as<std::string>();
+        output_args.num_files = args["files"].as<unsigned int>();
+        output_args.num_entries = args["entries"].as<unsigned int>();
+
+        try
+        {
+            std::tie(output_args.params.width, output_args.params.height) = parse_image_size(args["size"].as<std::string>());
+        }
+        catch(const std::runtime_error & e)
+        {
+            throw cxxopts::OptionException{e.what()};
+        }
+
+        output_args.params.mean_run = args["mean-run"].as<double>();
+        output_args.params.noise = args["noise"].as<double>();
+        output_args.params.palette = args["palette"].as<unsigned int>();
+        output_args.params.seed = args["seed"].as<std::uint32_t>();
+
+        if(args.count("profile"))
+        {
+            auto name = args["profile"].as<std::string>();
+            auto && profiles = synthetic_profiles();
+            auto profile = std::find_if(std::begin(profiles), std::end(profiles), [&name](auto && p) { return p.name == name; });
+            if(profile == std::end(profiles))
+                throw cxxopts::OptionException{"Unknown profile: " + name};
+
+            output_args.params.mean_run = profile->mean_run;
+            output_args.params.noise = profile->noise;
+            output_args.params.palette = profile->palette;
+        }
+
+        if(args.count("roundtrip"))
+            output_args.roundtrip_filenames = args["roundtrip"].as<std::vector<std::string>>();
+
+        return output_args;
+    }
+    catch(const cxxopts::OptionException & e)
+    {
+        std::cerr<<options.help()<<'\n'<<e.what()<<'\n';
+        return {};
+    }
+}
+
+void generate(const Args & args)
+{
+    for(auto file = 0u; file < args.num_files; ++file)
+    {
+        auto filename = std::filesystem::path{args.output_filename};
+        if(args.num_files > 1)
+            filename.replace_filename(filename.stem().string() + "_" + std::to_string(file) + filename.extension().string());
+
+        std::vector<Logo_image> images;
+        for(auto entry = 0u; entry < args.num_entries; ++entry)
+        {
+            auto params = args.params;
+            params.seed = args.params.seed + file * args.num_entries + entry;
+
+            auto im = make_synthetic_image(params);
+            im.name = "logo_synth_" + std::to_string(entry);
+            images.push_back({im.name, encode_image(im)});
+        }
+
+        auto data = build_logo(images);
+        std::ofstream{filename, std::ios::binary}.write(reinterpret_cast<const char *>(std::data(data)), std::size(data));
+
+        std::cout<<"Generated "<<filename.string()<<" ("<<args.num_entries<<" images, "<<std::size(data)<<" bytes)\n";
+    }
+}
+
+// decode every image in each file and build a new file from them, the same way logo2png and png2logo do (but without the PNGs).
+// Returns false if any file came back different
+bool roundtrip(const std::vector<std::string> & filenames)
+{
+    using clock = std::chrono::steady_clock;
+    auto all_match = true;
+
+    for(auto && filename: filenames)
+    {
+        auto file = Mapped_file{filename};
+        auto original = file.data();
+
+        auto start = clock::now();
+
+        std::vector<Image> decoded;
+        std::size_t pixels = 0;
+        for(auto && entry: parse_directory(original, filename))
+        {
+            decoded.push_back(decode_image(original, entry, filename));
+            pixels += decoded.back().width * decoded.back().height;
+        }
+
+        auto decoded_time = clock::now();
+
+        std::vector<Logo_image> images;
+        for(auto && im: decoded)
+            images.push_back({im.name, encode_image(im)});
+        auto repacked = build_logo(images);
+
+        auto end = clock::now();
+
+        auto decode_secs = std::chrono::duration<double>(decoded_time - start).count();
+        auto encode_secs = std::chrono::duration<double>(end - decoded_time).count();
+        auto mpx = pixels / 1e6;
+
+        auto match = std::size(repacked) == std::size(original) && std::equal(std::begin(repacked), std::end(repacked), std::begin(original));
+
+        std::cout<<filename<<": "<<(match ? "identical" : "DIFFERS")
+            <<", decode "<<decode_secs * 1000.0<<" ms ("<<mpx / decode_secs<<" Mpx/s)"
+            <<", encode "<<encode_secs * 1000.0<<" ms ("<<mpx / encode_secs<<" Mpx/s)\n";
+
+        if(!match)
+        {
+            auto mismatch = std::mismatch(std::begin(repacked), std::end(repacked), std::begin(original), std::end(original));
+            std::cout<<"  first difference at byte "<<std::distance(std::begin(repacked), mismatch.first)
+                <<" (sizes: "<<std::size(original)<<" original, "<<std::size(repacked)<<" repacked)\n";
+            all_match = false;
+        }
+    }
+
+    return all_match;
+}
+
+int main(int argc, char * argv[])
+{
+    auto args = get_args(argc, argv);
+    if(!args)
+        return EXIT_FAILURE;
+
+    try
+    {
+        if(!std::empty(args->roundtrip_filenames))
+            return roundtrip(args->roundtrip_filenames) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+        generate(*args);
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
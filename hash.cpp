@@ -0,0 +1,60 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+namespace
+{
+    // MurmurHash64A mixing, reading 8 bytes at a time
+    constexpr std::uint64_t mult = 0xc6a4a7935bd1e995ull;
+    constexpr int shift = 47;
+
+    std::uint64_t load64(const std::byte * p)
+    {
+        std::uint64_t k;
+        std::memcpy(&k, p, sizeof(k));
+        return k;
+    }
+}
+
+std::uint64_t hash_bytes(std::span<const std::byte> data, std::uint64_t seed)
+{
+    const auto len = std::size(data);
+    auto h = seed ^ (len * mult);
+
+    auto p = std::data(data);
+    const auto end = p + (len & ~std::size_t{7});
+    for(; p != end; p += 8)
+    {
+        auto k = load64(p);
+
+        k *= mult;
+        k ^= k >> shift;
+        k *= mult;
+
+        h ^= k;
+        h *= mult;
+    }
+
+    if(auto remaining = len & 7u; remaining)
+    {
+        std::uint64_t k = 0;
+        std::memcpy(&k, p, remaining);
+        h ^= k;
+        h *= mult;
+    }
+
+    h ^= h >> shift;
+    h *= mult;
+    h ^= h >> shift;
+
+    return h;
+}
+
+std::string hash_to_string(std::uint64_t hash)
+{
+    const char digits[] = "0123456789abcdef";
+    std::string s(16, '0');
+    for(auto i = 16u; i-- > 0; hash >>= 4)
+        s[i] = digits[hash & 0xFu];
+    return s;
+}
@@ -0,0 +1,16 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <span>
+#include <string>
+
+#include <cstddef>
+#include <cstdint>
+
+// fast, non-cryptographic 64 bit hash. Different seeds give independent hashes
+std::uint64_t hash_bytes(std::span<const std::byte> data, std::uint64_t seed = 0);
+
+// 16 digit lower case hex
+std::string hash_to_string(std::uint64_t hash);
+
+#endif // HASH_HPP
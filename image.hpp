@@ -1,33 +1,110 @@
 #ifndef IMAGE_HPP
 #define IMAGE_HPP
 
+#include <algorithm>
+#include <new>
 #include <string>
 #include <vector>
 
+#include <cstddef>
 #include <cstdint>
 
+// largest width or height a MotoRun image can store. Image readers reject anything larger
+constexpr std::size_t max_image_dimension = 0xFFFF;
+
+// image buffers start on this boundary, so SIMD code can use aligned loads on the first row
+constexpr std::size_t image_alignment = 64;
+
+template <typename T, std::size_t Alignment>
+struct Aligned_allocator
+{
+    using value_type = T;
+    template <typename U> struct rebind { using other = Aligned_allocator<U, Alignment>; };
+
+    Aligned_allocator() = default;
+    template <typename U> Aligned_allocator(const Aligned_allocator<U, Alignment> &) {}
+
+    T * allocate(std::size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Alignment})); }
+    void deallocate(T * p, std::size_t) { ::operator delete(p, std::align_val_t{Alignment}); }
+
+    bool operator==(const Aligned_allocator &) const = default;
+};
+
+// non-owning view of RGB pixels, where rows may be padded out past width * 3 bytes
+struct Image_view
+{
+    const std::uint8_t * data {nullptr};
+    std::size_t width {0};
+    std::size_t height {0};
+    std::size_t stride {0}; // bytes from the start of one row to the next
+
+    const std::uint8_t * row(std::size_t y) const { return data + y * stride; }
+    bool packed() const { return stride == width * 3; }
+};
+
 struct Image
 {
 public:
     Image() = default;
-    Image(std::size_t w, std::size_t h)
+    Image(std::size_t w, std::size_t h, std::size_t row_alignment = 0)
     {
-        set_size(w, h);
+        set_size(w, h, row_alignment);
     }
 
-    void set_size(std::size_t w, std::size_t h)
+    // when row_alignment is set, each row is padded out to a multiple of that many bytes, so every row starts aligned.
+    // Padding is zero filled, even when the buffer is reused. Rows are packed by default, which most formats and the cache rely on
+    void set_size(std::size_t w, std::size_t h, std::size_t row_alignment = 0)
     {
         width = w;
         height = h;
 
-        image_data.resize(w * h * 3);
+        stride = w * 3;
+        if(row_alignment > 0)
+            stride = (stride + row_alignment - 1) / row_alignment * row_alignment;
+
+        image_data.resize(stride * h);
+
+        // a reused buffer still holds the last image's pixels where the padding is now
+        if(stride > w * 3)
+        {
+            for(std::size_t y = 0; y < h; ++y)
+                std::fill(row(y) + w * 3, row(y) + stride, 0);
+        }
     }
 
+    std::uint8_t * row(std::size_t y) { return std::data(image_data) + y * stride; }
+    const std::uint8_t * row(std::size_t y) const { return std::data(image_data) + y * stride; }
+    bool packed() const { return stride == width * 3; }
+
+    Image_view view() const { return {std::data(image_data), width, height, stride}; }
+    operator Image_view() const { return view(); }
+
     std::size_t width{0};
     std::size_t height{0};
-    std::vector<std::uint8_t> image_data;
+    std::size_t stride{0};
+    std::vector<std::uint8_t, Aligned_allocator<std::uint8_t, image_alignment>> image_data;
 
     std::string name;
 };
 
+// writes an image file one row at a time, so the whole image doesn't need to be in memory
+class Row_writer
+{
+public:
+    virtual ~Row_writer() = default;
+
+    // width * 3 bytes of packed RGB
+    virtual void write_row(const std::uint8_t * row) = 0;
+    // must be called after all rows are written
+    virtual void finish() = 0;
+};
+
+// send every row of an image to a writer, skipping any row padding
+inline void write_rows(const Image_view & im, Row_writer & writer)
+{
+    for(std::size_t y = 0; y < im.height; ++y)
+        writer.write_row(im.row(y));
+    writer.finish();
+}
+
 #endif // IMAGE_HPP
@@ -1,17 +1,45 @@
 #include "logo.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
 #include <span>
 #include <stdexcept>
+#include <unordered_map>
 
+#include <cerrno>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <type_traits>
 
+#if __has_include(<stdlib.h>) && __has_include(<sys/stat.h>) && __has_include(<unistd.h>)
+#define HAS_MKSTEMP
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "cache.hpp"
+#include "formats.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
 #include "png.hpp"
 #include "readb.hpp"
+#include "simd.hpp"
 
 using namespace std::string_literals;
 
@@ -20,31 +48,31 @@ constexpr auto dir_entry_size = 32u;
 constexpr auto name_size = 24u;
 constexpr auto image_magic_size = 8u;
 
-void read_image_data(const std::span<std::byte> & data, const std::string & name, const std::string & input_filename)
+Image read_image_data_reference(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name)
 {
     auto input = std::begin(data);
 
     if(auto magic = readstr(input, std::end(data), image_magic_size); magic != "MotoRun\0"s)
-        throw std::runtime_error{"Error reading " + name + " from " + input_filename + ": bad identifier"};
+        throw std::runtime_error{"Error reading " + name + " from " + source_name + ": bad identifier"};
 
     auto width = readb<std::uint16_t>(input, std::end(data), std::endian::big);
     auto height = readb<std::uint16_t>(input, std::end(data), std::endian::big);
     Image im{width, height};
-    im.name = name + ".png";
+    im.name = name;
 
     for(auto px = std::begin(im.image_data); px < std::end(im.image_data) && input < std::end(data);)
     {
         auto count = readb<std::uint16_t>(input, std::end(data), std::endian::big);
         if(count & 0x7000u)
-            throw std::runtime_error{"Error reading " + name + " from " + input_filename + ": bad RLE count"};
+            throw std::runtime_error{"Error reading " + name + " from " + source_name + ": bad RLE count"};
 
         bool repeat = count & 0x8000u;
         count &= 0x0FFFu;
 
-        auto write_pix = [&px, &im, &name, &input_filename](std::uint8_t c)
+        auto write_pix = [&px, &im, &name, &source_name](std::uint8_t c)
         {
             if(px == std::end(im.image_data))
-                throw std::runtime_error{"Error reading " + name + " from " + input_filename + ": too many pixels"};
+                throw std::runtime_error{"Error reading " + name + " from " + source_name + ": too many pixels"};
             *px++ = c;
         };
 
@@ -76,172 +104,1645 @@ void read_image_data(const std::span<std::byte> & data, const std::string & name
         }
     }
 
-    std::cout<<"Extracted: "<<im.name<<" ("<<im.width<<"x"<<im.height<<")\n";
-    write_png(im);
+    return im;
 }
 
-void read_logo(const std::string & input_filename)
+Image_header read_image_header(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name)
 {
-    auto data = read_file(input_filename);
-    auto input = std::begin(data);
+    auto input = Byte_reader{data};
 
-    if(auto magic = readstr(input, std::end(data), magic_size); magic != "MotoLogo\0"s)
-        throw std::runtime_error{"Error reading " + input_filename + ": not a Moto logo.bin file"};
+    if(auto magic = input.read_str(image_magic_size); magic != "MotoRun\0"s)
+        throw std::runtime_error{"Error reading " + name + " from " + source_name + ": bad identifier"};
 
-    auto directory_size = readb<std::uint32_t>(input, std::end(data), std::endian::little);
+    Image_header header;
+    header.width = input.read<std::uint16_t>(std::endian::big);
+    header.height = input.read<std::uint16_t>(std::endian::big);
 
-    const auto num_images = (directory_size - magic_size - sizeof(directory_size)) / dir_entry_size;
+    return header;
+}
 
-    for(auto i = 0u; i < num_images; ++i)
+namespace
+{
+    constexpr auto image_header_size = image_magic_size + 2 * sizeof(std::uint16_t);
+
+    // bounds are checked once per packet, then each packet is passed to packet_func(repeat, bgr_data, count) to be copied or filled in bulk.
+    // Stops after num_pixels, or at the end of data, or when packet_func returns false, if it returns anything.
+    // Returns the number of pixels not reached
+    template <typename Packet_func>
+    std::size_t decode_packets(const std::span<const std::byte> & data, std::size_t num_pixels, const std::string & name, const std::string & source_name, Packet_func && packet_func)
+    {
+        auto in = reinterpret_cast<const std::uint8_t *>(std::data(data)) + image_header_size;
+        const auto in_end = reinterpret_cast<const std::uint8_t *>(std::data(data) + std::size(data));
+
+        while(num_pixels > 0 && in < in_end)
+        {
+            if(in_end - in < 2)
+                throw std::runtime_error{"Unexpected end of input"};
+
+            std::uint16_t count = (in[0] << 8) | in[1];
+            in += 2;
+
+            if(count & 0x7000u)
+                throw std::runtime_error{"Error reading " + name + " from " + source_name + ": bad RLE count"};
+
+            bool repeat = count & 0x8000u;
+            count &= 0x0FFFu;
+
+            if(num_pixels < count)
+                throw std::runtime_error{"Error reading " + name + " from " + source_name + ": too many pixels"};
+
+            const auto packet_size = repeat ? 3u : count * 3u;
+            if(static_cast<std::size_t>(in_end - in) < packet_size)
+                throw std::runtime_error{"Unexpected end of input"};
+
+            in += packet_size;
+            num_pixels -= count;
+
+            if constexpr(std::is_same_v<std::invoke_result_t<Packet_func &, bool, const std::uint8_t *, std::size_t>, bool>)
+            {
+                if(!packet_func(repeat, in - packet_size, count))
+                    break;
+            }
+            else
+                packet_func(repeat, in - packet_size, count);
+        }
+
+        return num_pixels;
+    }
+
+    // decode into num_pixels * 3 bytes of RGB at px. Returns the number of pixels missing from the end of data, which are left as-is
+    std::size_t decode_pixels(const std::span<const std::byte> & data, std::size_t num_pixels, const std::string & name, const std::string & source_name, std::uint8_t * px)
+    {
+        return decode_packets(data, num_pixels, name, source_name, [&px](bool repeat, const std::uint8_t * bgr, std::size_t count)
+        {
+            if(repeat)
+                fill_rgb(px, bgr[2], bgr[1], bgr[0], count);
+            else
+                bgr_to_rgb(bgr, px, count);
+
+            px += count * 3u;
+        });
+    }
+}
+
+namespace
+{
+    // decode into rows of width * 3 bytes, splitting up packets that run on past the end of a row.
+    // Row y is decoded to row_ptr(y), then passed to row_done(y). Pixels missing from the end of the data are left black
+    template <typename Row_ptr, typename Row_done>
+    void decode_rows(const std::span<const std::byte> & data, const Image_header & header, const std::string & name, const std::string & source_name, Row_ptr && row_ptr, Row_done && row_done)
     {
-        auto name = readstr(input, std::end(data), name_size);
-        auto offset = readb<std::uint32_t>(input, std::end(data), std::endian::little);
-        auto size = readb<std::uint32_t>(input, std::end(data), std::endian::little);
+        const auto row_size = header.width * 3;
+        std::size_t y = 0;
+        auto px = row_ptr(y);
+        auto row_end = px + row_size;
+
+        auto next_row = [&]()
+        {
+            row_done(y);
+            if(++y < header.height)
+            {
+                px = row_ptr(y);
+                row_end = px + row_size;
+            }
+        };
+
+        decode_packets(data, header.width * header.height, name, source_name, [&](bool repeat, const std::uint8_t * bgr, std::size_t count)
+        {
+            while(count > 0)
+            {
+                auto n = std::min<std::size_t>(count, (row_end - px) / 3);
+
+                if(repeat)
+                    fill_rgb(px, bgr[2], bgr[1], bgr[0], n);
+                else
+                {
+                    bgr_to_rgb(bgr, px, n);
+                    bgr += n * 3;
+                }
+
+                px += n * 3;
+                count -= n;
+
+                if(px == row_end)
+                    next_row();
+            }
+        });
+
+        while(y < header.height)
+        {
+            std::fill(px, row_end, 0);
+            next_row();
+        }
+    }
+}
+
+void read_image_data(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name, Image & im, std::size_t row_alignment)
+{
+    auto header = read_image_header(data, name, source_name);
 
-        name.resize(name.find_first_of('\0'));
+    im.set_size(header.width, header.height, row_alignment);
+    im.name = name;
 
-        if(offset < directory_size || offset + size > std::size(data))
-            throw std::runtime_error{"Error reading " + name + " from " + input_filename + ": bad offset and size"};
+    if(header.width == 0 || header.height == 0)
+        return;
 
-        read_image_data(std::span{std::begin(data) + offset, std::begin(data) + offset + size}, name, input_filename);
+    if(im.packed())
+    {
+        // the whole image is one run of pixels, so packets never need to be split up
+        auto missing = decode_pixels(data, header.width * header.height, name, source_name, std::data(im.image_data));
+        std::fill(std::end(im.image_data) - missing * 3, std::end(im.image_data), 0); // black, and not left over from a reused buffer
     }
+    else
+        decode_rows(data, header, name, source_name, [&im](std::size_t y) { return im.row(y); }, [](std::size_t) {});
+}
+
+Image read_image_data(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name)
+{
+    Image im;
+    read_image_data(data, name, source_name, im);
+    return im;
 }
 
-std::vector<std::byte> write_image(const std::string & filename)
+void read_image_rows(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name, const std::function<void(const std::uint8_t *)> & row_func)
 {
-    std::vector<std::byte> data;
-    auto output = std::back_inserter(data);
+    auto header = read_image_header(data, name, source_name);
+    if(header.width == 0 || header.height == 0)
+        return;
 
-    auto im = read_png(filename);
+    std::vector<std::uint8_t> row(header.width * 3);
+    decode_rows(data, header, name, source_name, [&row](std::size_t) { return std::data(row); }, [&row, &row_func](std::size_t) { row_func(std::data(row)); });
+}
 
-    writestr("MotoRun\0"s, image_magic_size, output);
-    writeb(static_cast<std::uint16_t>(im.width), output, std::endian::big);
-    writeb(static_cast<std::uint16_t>(im.height), output, std::endian::big);
+Rle_stats rle_stats(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name)
+{
+    auto header = read_image_header(data, name, source_name);
 
-    for(auto row = 0u; row < im.height; ++row)
+    Rle_stats stats;
+    decode_packets(data, header.width * header.height, name, source_name, [&stats](bool repeat, const std::uint8_t *, std::size_t count)
     {
-        auto non_rle_buffer = std::vector<std::byte>{};
-        auto write_non_rle = [&non_rle_buffer, &output]()
+        if(repeat)
         {
-            if(std::empty(non_rle_buffer))
-                return;
+            ++stats.repeat_packets;
+            stats.repeat_pixels += count;
+        }
+        else
+        {
+            ++stats.literal_packets;
+            stats.literal_pixels += count;
+        }
+    });
 
-            std::uint16_t count = std::size(non_rle_buffer) / 3u;
-            if(count >= 0x1000)
-                throw std::logic_error {"Too many non-RLE pixels"};
-            writeb(count, output, std::endian::big);
+    return stats;
+}
+
+std::vector<std::pair<Rgb, std::uint64_t>> color_histogram(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name)
+{
+    auto header = read_image_header(data, name, source_name);
+
+    // keyed by packed BGR, as stored
+    std::unordered_map<std::uint32_t, std::uint64_t> counts;
+    decode_packets(data, header.width * header.height, name, source_name, [&counts](bool repeat, const std::uint8_t * bgr, std::size_t count)
+    {
+        if(repeat)
+            counts[bgr[0] | (bgr[1] << 8) | (bgr[2] << 16)] += count;
+        else
+        {
+            for(std::size_t i = 0; i < count; ++i, bgr += 3)
+                ++counts[bgr[0] | (bgr[1] << 8) | (bgr[2] << 16)];
+        }
+    });
+
+    std::vector<std::pair<Rgb, std::uint64_t>> histogram;
+    for(auto && [color, count]: counts)
+        histogram.emplace_back(Rgb{static_cast<std::uint8_t>(color >> 16), static_cast<std::uint8_t>(color >> 8), static_cast<std::uint8_t>(color)}, count);
+
+    std::sort(std::begin(histogram), std::end(histogram), [](const auto & a, const auto & b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+
+    return histogram;
+}
+
+std::vector<std::byte> recolor_image(const std::span<const std::byte> & data, Rgb from, Rgb to, const std::string & name, const std::string & source_name)
+{
+    auto header = read_image_header(data, name, source_name);
+
+    std::vector<std::byte> output(std::begin(data), std::end(data));
+    const auto in_start = reinterpret_cast<const std::uint8_t *>(std::data(data));
+    const auto out_start = reinterpret_cast<std::uint8_t *>(std::data(output));
+
+    auto recolor = [&](const std::uint8_t * bgr)
+    {
+        if(bgr[0] == from.b && bgr[1] == from.g && bgr[2] == from.r)
+        {
+            auto out = out_start + (bgr - in_start);
+            out[0] = to.b;
+            out[1] = to.g;
+            out[2] = to.r;
+        }
+    };
+
+    decode_packets(data, header.width * header.height, name, source_name, [&recolor](bool repeat, const std::uint8_t * bgr, std::size_t count)
+    {
+        if(repeat)
+            recolor(bgr);
+        else
+        {
+            for(std::size_t i = 0; i < count; ++i, bgr += 3)
+                recolor(bgr);
+        }
+    });
+
+    return output;
+}
+
+std::vector<std::byte> crop_image_rows(const std::span<const std::byte> & data, std::size_t first_row, std::size_t num_rows, const std::string & name, const std::string & source_name)
+{
+    auto header = read_image_header(data, name, source_name);
+    if(first_row > header.height || num_rows > header.height - first_row)
+        throw std::runtime_error{"Error cropping " + name + " from " + source_name + ": rows " + std::to_string(first_row) + " - " + std::to_string(first_row + num_rows)
+            + " are outside of the image (" + std::to_string(header.width) + "x" + std::to_string(header.height) + ")"};
+
+    // every packet kept is either copied, or split into a smaller one, so the output is never larger than the input
+    std::vector<std::byte> output(std::size(data));
+    auto out = Byte_writer{output};
 
-            for(auto i = 0u; i < std::size(non_rle_buffer); i += 3)
+    out.write_str("MotoRun\0"s, image_magic_size);
+    out.write(static_cast<std::uint16_t>(header.width), std::endian::big);
+    out.write(static_cast<std::uint16_t>(num_rows), std::endian::big);
+
+    // pixel indexes of the rows kept
+    const auto keep_begin = first_row * header.width;
+    const auto keep_end = keep_begin + num_rows * header.width;
+    std::size_t pos = 0;
+
+    // packets may run on past the last row kept, so they're walked against the whole image, and the walk stops after the crop
+    decode_packets(data, header.width * header.height, name, source_name, [&](bool repeat, const std::uint8_t * bgr, std::size_t count)
+    {
+        const auto packet_begin = pos;
+        const auto packet_end = pos + count;
+        pos = packet_end;
+
+        const auto begin = std::max(packet_begin, keep_begin);
+        const auto end = std::min(packet_end, keep_end);
+        if(begin < end)
+        {
+            if(begin == packet_begin && end == packet_end)
             {
-                writeb(non_rle_buffer[i + 2], output); // B
-                writeb(non_rle_buffer[i + 1], output); // G
-                writeb(non_rle_buffer[i + 0], output); // R
+                // entirely inside the crop. Copy the whole packet as-is
+                out.write_bytes(bgr - 2, 2 + (repeat ? 3u : count * 3u));
             }
-            non_rle_buffer.clear();
-        };
-        auto write_rle =[&output](std::byte r, std::byte g, std::byte b, std::uint16_t count)
+            else
+            {
+                // split
+                auto new_count = static_cast<std::uint16_t>(end - begin);
+                out.write(static_cast<std::uint16_t>(new_count | (repeat ? 0x8000u : 0u)), std::endian::big);
+                out.write_bytes(repeat ? bgr : bgr + (begin - packet_begin) * 3, repeat ? 3u : new_count * 3u);
+            }
+        }
+
+        return pos < keep_end;
+    });
+
+    output.resize(out.position());
+    return output;
+}
+
+std::vector<Logo_entry> parse_directory(std::span<const std::byte> logo, const std::string & source_name)
+{
+    auto input = Byte_reader{logo};
+
+    if(auto magic = input.read_str(magic_size); magic != "MotoLogo\0"s)
+        throw std::runtime_error{"Error reading " + source_name + ": not a Moto logo.bin file"};
+
+    auto directory_size = input.read<std::uint32_t>(std::endian::little);
+    if(directory_size < magic_size + sizeof(directory_size))
+        throw std::runtime_error{"Error reading " + source_name + ": bad directory size"};
+
+    const auto num_images = (directory_size - magic_size - sizeof(directory_size)) / dir_entry_size;
+    if(num_images * dir_entry_size > input.remaining())
+        throw std::runtime_error{"Unexpected end of input"};
+
+    std::vector<Logo_entry> entries;
+    entries.reserve(num_images);
+
+    for(auto i = 0u; i < num_images; ++i)
+    {
+        Logo_entry entry;
+        entry.name = input.read_str(name_size);
+        entry.offset = input.read<std::uint32_t>(std::endian::little);
+        entry.size = input.read<std::uint32_t>(std::endian::little);
+
+        if(auto name_end = entry.name.find_first_of('\0'); name_end != std::string::npos)
+            entry.name.resize(name_end);
+
+        if(entry.offset < directory_size || entry.offset > std::size(logo) || entry.size > std::size(logo) - entry.offset)
+            throw std::runtime_error{"Error reading " + entry.name + " from " + source_name + ": bad offset and size"};
+
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
+
+std::span<const std::byte> entry_data(std::span<const std::byte> logo, const Logo_entry & entry)
+{
+    return logo.subspan(entry.offset, entry.size);
+}
+
+Image decode_image(std::span<const std::byte> logo, const Logo_entry & entry, const std::string & source_name)
+{
+    return read_image_data(entry_data(logo, entry), entry.name, source_name);
+}
+
+bool glob_match(std::string_view pattern, std::string_view name)
+{
+    std::size_t p = 0, n = 0;
+
+    // where to resume if we need to let the last '*' match one more character
+    std::size_t star = std::string_view::npos, star_n = 0;
+
+    while(n < std::size(name))
+    {
+        if(p < std::size(pattern) && (pattern[p] == '?' || pattern[p] == name[n]))
         {
-            if(count >= 0x1000)
-                throw std::logic_error {"Too many RLE pixels"};
-            count |= 0x8000;
-            writeb(count, output, std::endian::big);
+            ++p;
+            ++n;
+        }
+        else if(p < std::size(pattern) && pattern[p] == '*')
+        {
+            star = p++;
+            star_n = n;
+        }
+        else if(star != std::string_view::npos)
+        {
+            p = star + 1;
+            n = ++star_n;
+        }
+        else
+            return false;
+    }
 
-            writeb(b, output);
-            writeb(g, output);
-            writeb(r, output);
-        };
+    while(p < std::size(pattern) && pattern[p] == '*')
+        ++p;
+
+    return p == std::size(pattern);
+}
+
+std::vector<Logo_entry> select_entries(const std::vector<Logo_entry> & entries, const std::vector<std::string> & patterns, const std::string & source_name)
+{
+    std::vector<bool> matched(std::size(patterns), false);
+    std::vector<Logo_entry> selected;
+
+    for(auto && entry: entries)
+    {
+        auto match = false;
+        for(auto i = 0u; i < std::size(patterns); ++i)
+        {
+            if(glob_match(patterns[i], entry.name))
+                match = matched[i] = true;
+        }
+
+        if(match)
+            selected.push_back(entry);
+    }
+
+    for(auto i = 0u; i < std::size(patterns); ++i)
+    {
+        if(!matched[i])
+            throw std::runtime_error{"Error reading " + source_name + ": no entries match " + patterns[i]};
+    }
+
+    return selected;
+}
+
+namespace
+{
+    std::uint32_t directory_size(std::size_t num_images)
+    {
+        return num_images * dir_entry_size + magic_size + sizeof(std::uint32_t);
+    }
+
+    // fill in the logo's total alignment padding, and the padding after each image in stats.entries.
+    // entries is the complete directory, which the images in stats.entries must be a part of
+    void padding_stats(const std::vector<Logo_entry> & entries, const std::vector<Logo_entry> & selected, Logo_stats & stats)
+    {
+        auto sorted = entries;
+        std::sort(std::begin(sorted), std::end(sorted), [](const auto & a, const auto & b) { return a.offset < b.offset; });
+
+        // everything not covered by the directory or an image
+        std::uint64_t end = directory_size(std::size(entries));
+        stats.padding = 0;
+        for(auto && entry: sorted)
+        {
+            if(entry.offset > end)
+                stats.padding += entry.offset - end;
+            end = std::max<std::uint64_t>(end, entry.offset + entry.size);
+        }
+        if(stats.file_size > end)
+            stats.padding += stats.file_size - end;
 
-        for(auto col = 0u; col < im.width;)
+        // each image's padding runs up to the next image, or the end of the file
+        for(std::size_t i = 0; i < std::size(selected) && i < std::size(stats.entries); ++i)
         {
-            auto current_r = static_cast<std::byte>(im.image_data[(row * im.width + col) * 3]);
-            auto current_g = static_cast<std::byte>(im.image_data[(row * im.width + col) * 3 + 1]);
-            auto current_b = static_cast<std::byte>(im.image_data[(row * im.width + col) * 3 + 2]);
+            const std::uint64_t image_end = selected[i].offset + selected[i].size;
+            auto next = std::lower_bound(std::begin(sorted), std::end(sorted), image_end, [](const auto & entry, std::uint64_t offset) { return entry.offset < offset; });
+            auto next_offset = next == std::end(sorted) ? stats.file_size : next->offset;
+            stats.entries[i].padding = next_offset > image_end ? next_offset - image_end : 0;
+        }
+    }
+
+    // extract every job's images with one shared pool of workers. Returns the error for each job, or null if it succeeded
+    std::vector<std::exception_ptr> extract_logos(const std::vector<Extract_job> & jobs, const Extract_options & options)
+    {
+        struct Input
+        {
+            std::unique_ptr<Mapped_file> file;
+            std::vector<Logo_entry> entries;
+            std::exception_ptr error;
+            std::size_t error_index {0};
+            std::atomic<bool> failed {false};
+            std::atomic<std::size_t> remaining {0};
+        };
+        std::vector<Input> inputs(std::size(jobs));
 
-            std::uint16_t count = 1u;
+        if(options.stats)
+            options.stats->assign(std::size(jobs), {});
 
-            for(auto x = col + 1; x < im.width && count < 0x1000; ++x, ++count)
+        // directories are small, so they're all read up front. Only the selected images are read after that
+        parallel_for(std::size(jobs), options.num_threads, [&](std::size_t j)
+        {
+            auto stats = options.stats ? &(*options.stats)[j] : nullptr;
+            try
             {
-                auto r = static_cast<std::byte>(im.image_data[(row * im.width + x) * 3]);
-                auto g = static_cast<std::byte>(im.image_data[(row * im.width + x) * 3 + 1]);
-                auto b = static_cast<std::byte>(im.image_data[(row * im.width + x) * 3 + 2]);
+                auto start = std::chrono::steady_clock::now();
+                inputs[j].file = std::make_unique<Mapped_file>(jobs[j].input_filename);
+                auto data = inputs[j].file->data();
 
-                if(r != current_r || g != current_g || b != current_b)
-                    break;
+                if(stats)
+                {
+                    stats->filename = jobs[j].input_filename;
+                    stats->file_size = std::size(data);
+                    stats->read_seconds = seconds_since(start);
+                    start = std::chrono::steady_clock::now();
+                }
+
+                auto all_entries = parse_directory(data, jobs[j].input_filename);
+                inputs[j].entries = std::empty(options.only) ? all_entries : select_entries(all_entries, options.only, jobs[j].input_filename);
+
+                if(stats)
+                {
+                    stats->parse_seconds = seconds_since(start);
+                    stats->entries.resize(std::size(inputs[j].entries));
+                    for(std::size_t i = 0; i < std::size(inputs[j].entries); ++i)
+                    {
+                        auto & entry = inputs[j].entries[i];
+                        stats->entries[i].name = entry.name;
+                        stats->entries[i].compressed_size = entry.size;
+                    }
+                    padding_stats(all_entries, inputs[j].entries, *stats);
+                }
+
+                if(!std::empty(jobs[j].output_dir))
+                    std::filesystem::create_directories(jobs[j].output_dir);
+            }
+            catch(...)
+            {
+                inputs[j].error = std::current_exception();
+                inputs[j].file.reset();
+                inputs[j].entries.clear();
+                if(stats)
+                    stats->entries.clear();
             }
+            inputs[j].remaining = std::size(inputs[j].entries);
+        });
 
-            if(count > 2)
+        // every (input, entry) pair goes into one queue, so many small files keep every core busy
+        std::vector<std::pair<std::size_t, std::size_t>> work;
+        for(std::size_t j = 0; j < std::size(inputs); ++j)
+        {
+            for(std::size_t i = 0; i < std::size(inputs[j].entries); ++i)
+                work.emplace_back(j, i);
+        }
+
+        // images are decoded and written out of order, but reported in order
+        std::mutex print_mutex;
+        std::vector<std::optional<std::string>> messages(std::size(work));
+        auto next_to_print = 0u;
+
+        parallel_for(std::size(work), options.num_threads, [&](std::size_t w)
+        {
+            auto [j, i] = work[w];
+            auto & input = inputs[j];
+            auto & entry = input.entries[i];
+
+            std::string message;
+            std::string partial_filename; // set while an output file is being written, so it can be removed if that fails
+            if(!input.failed)
             {
-                write_non_rle();
-                write_rle(current_r, current_g, current_b, count);
-                col += count;
+                try
+                {
+                    // stream rows straight from the decoder to the image writer, so the whole image never needs to be in memory
+                    auto image_data = entry_data(input.file->data(), entry);
+                    auto header = read_image_header(image_data, entry.name, jobs[j].input_filename);
+                    auto filename = (std::filesystem::path{jobs[j].output_dir} / (entry.name + format_extension(options.format))).string();
+
+                    // every packet is checked before the output file is opened, so a corrupt entry doesn't leave a partial image behind.
+                    // Only packets are counted, so this is cheap next to decoding
+                    auto rle = rle_stats(image_data, entry.name, jobs[j].input_filename);
+
+                    partial_filename = filename;
+                    if(!options.stats)
+                    {
+                        auto writer = make_row_writer(filename, header.width, header.height, options.format, options.png_options);
+                        read_image_rows(image_data, entry.name, jobs[j].input_filename, [&writer](const std::uint8_t * row) { writer->write_row(row); });
+                        writer->finish();
+                    }
+                    else
+                    {
+                        // decoding and writing are interleaved row by row, so time spent writing is subtracted out of the total
+                        auto & stats = (*options.stats)[j].entries[i];
+                        stats.width = header.width;
+                        stats.height = header.height;
+                        stats.raw_size = static_cast<std::uint64_t>(header.width) * header.height * 3u;
+                        stats.rle = rle;
+
+                        const auto start = std::chrono::steady_clock::now();
+                        auto writer_start = start;
+                        auto writer = make_row_writer(filename, header.width, header.height, options.format, options.png_options);
+                        stats.image_seconds = seconds_since(writer_start);
+
+                        read_image_rows(image_data, entry.name, jobs[j].input_filename, [&writer, &stats](const std::uint8_t * row)
+                        {
+                            auto row_start = std::chrono::steady_clock::now();
+                            writer->write_row(row);
+                            stats.image_seconds += seconds_since(row_start);
+                        });
+
+                        writer_start = std::chrono::steady_clock::now();
+                        writer->finish();
+                        stats.image_seconds += seconds_since(writer_start);
+                        stats.rle_seconds = seconds_since(start) - stats.image_seconds;
+                    }
+                    partial_filename.clear();
+
+                    message = "Extracted: " + filename + " (" + std::to_string(header.width) + "x" + std::to_string(header.height) + ")\n";
+                }
+                catch(...)
+                {
+                    if(!std::empty(partial_filename))
+                    {
+                        std::error_code ec;
+                        std::filesystem::remove(partial_filename, ec);
+                    }
+
+                    // once an image fails, the rest of that input is skipped
+                    input.failed = true;
+
+                    std::scoped_lock lock{print_mutex};
+                    if(!input.error || i < input.error_index)
+                    {
+                        input.error = std::current_exception();
+                        input.error_index = i;
+                    }
+                }
             }
-            else
+
+            // the last image done with an input releases it, so only the inputs in progress stay mapped
+            if(--input.remaining == 0)
+                input.file.reset();
+
+            std::scoped_lock lock{print_mutex};
+            messages[w] = std::move(message);
+            for(; next_to_print < std::size(messages) && messages[next_to_print]; ++next_to_print)
             {
-                non_rle_buffer.emplace_back(current_r);
-                non_rle_buffer.emplace_back(current_g);
-                non_rle_buffer.emplace_back(current_b);
-                if(std::size(non_rle_buffer) / 3 == 0x1000)
-                    write_non_rle();
-                ++col;
+                if(options.progress)
+                    *options.progress<<*messages[next_to_print];
             }
-        }
+        });
+
+        std::vector<std::exception_ptr> errors;
+        for(auto && input: inputs)
+            errors.push_back(input.error);
 
-        write_non_rle();
+        return errors;
     }
+}
 
-    return data;
+void read_logo(const std::string & input_filename, const Extract_options & options)
+{
+    auto errors = extract_logos({{input_filename, options.output_dir}}, options);
+    if(errors.front())
+        std::rethrow_exception(errors.front());
 }
 
-void write_logo(const std::vector<std::string> & filenames, const std::string & output_filename)
+void read_logos(const std::vector<Extract_job> & jobs, const Extract_options & options)
 {
-    std::uint32_t header_size = std::size(filenames) * dir_entry_size + magic_size + sizeof(std::uint32_t);
+    auto errors = extract_logos(jobs, options);
+
+    auto num_failed = 0u;
+    for(std::size_t j = 0; j < std::size(jobs); ++j)
+    {
+        if(!errors[j])
+            continue;
+
+        ++num_failed;
+        try
+        {
+            std::rethrow_exception(errors[j]);
+        }
+        catch(const std::exception & e)
+        {
+            std::cerr<<"Failed: "<<jobs[j].input_filename<<": "<<e.what()<<'\n';
+        }
+    }
+
+    if(num_failed > 0)
+        throw std::runtime_error{std::to_string(num_failed) + " of " + std::to_string(std::size(jobs)) + " inputs failed"};
+}
 
-    std::vector<std::byte> data(header_size, std::byte{0xFF});
-    auto output = std::begin(data);
+std::vector<Verify_result> verify_logo(std::span<const std::byte> logo, const std::string & source_name, const Verify_options & options)
+{
+    auto entries = parse_directory(logo, source_name);
 
-    writestr("MotoLogo\0"s, magic_size, output);
-    writeb(header_size, output, std::endian::little);
+    std::vector<Verify_result> results(std::size(entries));
+    for(std::size_t i = 0; i < std::size(entries); ++i)
+        results[i].name = entries[i].name;
 
-    auto round_to_mod512 = [](auto i) -> decltype(i)
+    auto add_error = [&results](std::size_t i, const std::string & error)
     {
-        auto diff = 512u - (i % 512u);
-        return i + (diff == 512u ? 0u : diff);
+        if(!std::empty(results[i].error))
+            results[i].error += "; ";
+        results[i].error += error;
     };
 
-    for(auto && filename: filenames)
+    // parse_directory already checked that every image is inside the file. Here, check them against each other
+    std::vector<std::size_t> by_offset(std::size(entries));
+    std::iota(std::begin(by_offset), std::end(by_offset), 0u);
+    std::sort(std::begin(by_offset), std::end(by_offset), [&entries](auto a, auto b)
+    {
+        return std::pair{entries[a].offset, entries[a].size} < std::pair{entries[b].offset, entries[b].size};
+    });
+
+    // images that haven't ended yet, by the start of the current one. Anything starting before an open image's end overlaps it,
+    // unless it's the same data. Every open image is checked, so each member of a shared group is reported
+    std::vector<std::size_t> open;
+    for(auto i: by_offset)
+    {
+        auto end = [&entries](std::size_t e) { return static_cast<std::uint64_t>(entries[e].offset) + entries[e].size; };
+
+        open.erase(std::remove_if(std::begin(open), std::end(open), [&](auto o) { return end(o) <= entries[i].offset; }), std::end(open));
+
+        for(auto o: open)
+        {
+            auto & other = entries[o];
+            if(entries[i].offset == other.offset && entries[i].size == other.size)
+                continue;
+
+            add_error(i, "overlaps " + other.name);
+            add_error(o, "overlaps " + entries[i].name);
+        }
+
+        open.push_back(i);
+    }
+
+    for(std::size_t i = 0; i < std::size(entries); ++i)
+    {
+        for(std::size_t j = 0; j < i; ++j)
+        {
+            if(entries[i].name == entries[j].name)
+            {
+                add_error(i, "duplicate name");
+                break;
+            }
+        }
+    }
+
+    std::vector<std::size_t> selected;
+    if(std::empty(options.only))
+    {
+        selected.resize(std::size(entries));
+        std::iota(std::begin(selected), std::end(selected), 0u);
+    }
+    else
+    {
+        select_entries(entries, options.only, source_name); // throws if a pattern doesn't match anything
+        for(std::size_t i = 0; i < std::size(entries); ++i)
+        {
+            if(std::any_of(std::begin(options.only), std::end(options.only), [&](const auto & pattern) { return glob_match(pattern, entries[i].name); }))
+                selected.push_back(i);
+        }
+    }
+
+    parallel_for(std::size(selected), options.num_threads, [&](std::size_t s)
     {
-        auto image_data = write_image(filename);
+        auto i = selected[s];
+        auto & result = results[i];
+        try
+        {
+            auto data = entry_data(logo, entries[i]);
+            auto header = read_image_header(data, entries[i].name, source_name);
+            result.width = header.width;
+            result.height = header.height;
 
-        if(std::size(image_data) > std::numeric_limits<std::uint32_t>::max())
-            throw std::runtime_error{"Error writing " + filename + " compressed image size is too large"};
+            const auto num_pixels = header.width * header.height;
+            std::size_t missing = 0;
 
-        if(std::size(data) + std::size(image_data) > std::numeric_limits<std::uint32_t>::max())
-            throw std::runtime_error{"Error writing " + filename + " total image size is too large"};
+            if(options.hash)
+            {
+                // reused between images, so verifying doesn't allocate for every one
+                thread_local std::vector<std::uint8_t> scratch;
+                scratch.resize(num_pixels * 3);
 
-        // save our output iterator in case the resize reallocates it
-        auto output_offset = std::distance(std::begin(data), output);
+                missing = decode_pixels(data, num_pixels, entries[i].name, source_name, std::data(scratch));
+                std::fill(std::end(scratch) - missing * 3, std::end(scratch), 0); // black, like the decoders
+                result.hash = hash_bytes(std::as_bytes(std::span{scratch}));
+            }
+            else
+            {
+                // checking the packets is all it takes to validate an image. Nothing needs to be copied
+                missing = decode_packets(data, num_pixels, entries[i].name, source_name, [](bool, const std::uint8_t *, std::size_t) {});
+            }
 
-        data.resize(round_to_mod512(std::size(data)), std::byte{0xFF});
-        auto offset = static_cast<std::uint32_t>(std::size(data));
-        data.insert(std::end(data), std::begin(image_data), std::end(image_data));
+            if(missing > 0)
+                add_error(i, std::to_string(missing) + " of " + std::to_string(num_pixels) + " pixels missing");
+        }
+        catch(const std::runtime_error & e)
+        {
+            add_error(i, e.what());
+        }
+    });
 
-        output = std::begin(data) + output_offset;
+    std::vector<Verify_result> selected_results;
+    for(auto i: selected)
+        selected_results.push_back(std::move(results[i]));
 
-        auto ext_start = filename.find_last_of('.');
-        auto dir_end = filename.find_last_of("/\\");
-        if(dir_end == std::string::npos)
-            dir_end = 0;
-        auto name = filename.substr(dir_end, ext_start - dir_end);
+    return selected_results;
+}
 
-        if(std::size(name) > name_size - 1)
-            throw std::runtime_error{"Error writing " + name + " filename exceeds maximum length(" + std::to_string(name_size - 1) + " characters)"};
+std::vector<Verify_result> verify_logo(const std::string & input_filename, const Verify_options & options)
+{
+    auto file = Mapped_file{input_filename};
+    return verify_logo(file.data(), input_filename, options);
+}
 
-        writestr(name, name_size, output);
-        writeb(offset, output, std::endian::little);
-        writeb(static_cast<std::uint32_t>(std::size(image_data)), output, std::endian::little);
+std::vector<Entry_diff> diff_logos(std::span<const std::byte> old_logo, const std::string & old_name,
+    std::span<const std::byte> new_logo, const std::string & new_name, unsigned int num_threads)
+{
+    auto old_entries = parse_directory(old_logo, old_name);
+    auto new_entries = parse_directory(new_logo, new_name);
 
-        std::cout<<"Wrote "<<name<<'\n';
+    auto find = [](const std::vector<Logo_entry> & entries, const std::string & name)
+    {
+        return std::find_if(std::begin(entries), std::end(entries), [&name](const auto & entry) { return entry.name == name; });
+    };
+
+    // old entry, new entry
+    std::vector<std::pair<const Logo_entry *, const Logo_entry *>> pairs;
+    for(auto && entry: old_entries)
+    {
+        auto match = find(new_entries, entry.name);
+        pairs.emplace_back(&entry, match == std::end(new_entries) ? nullptr : &*match);
+    }
+    for(auto && entry: new_entries)
+    {
+        if(find(old_entries, entry.name) == std::end(old_entries))
+            pairs.emplace_back(nullptr, &entry);
+    }
+
+    std::vector<Entry_diff> diffs(std::size(pairs));
+
+    parallel_for(std::size(pairs), num_threads, [&](std::size_t i)
+    {
+        auto [old_entry, new_entry] = pairs[i];
+        auto & diff = diffs[i];
+        diff.name = old_entry ? old_entry->name : new_entry->name;
+
+        if(old_entry)
+        {
+            auto data = entry_data(old_logo, *old_entry);
+            diff.old_header = read_image_header(data, old_entry->name, old_name);
+            diff.old_hash = hash_bytes(data);
+        }
+        if(new_entry)
+        {
+            auto data = entry_data(new_logo, *new_entry);
+            diff.new_header = read_image_header(data, new_entry->name, new_name);
+            diff.new_hash = hash_bytes(data);
+        }
+
+        if(!new_entry)
+        {
+            diff.status = Diff_status::removed;
+            return;
+        }
+        if(!old_entry)
+        {
+            diff.status = Diff_status::added;
+            return;
+        }
+
+        // the common case. Nothing to decode
+        if(old_entry->size == new_entry->size && diff.old_hash == diff.new_hash)
+        {
+            diff.status = Diff_status::same;
+            return;
+        }
+
+        if(diff.old_header.width != diff.new_header.width || diff.old_header.height != diff.new_header.height)
+        {
+            diff.status = Diff_status::resized;
+            return;
+        }
+
+        // reused between entries, so only the first pair of images on each thread allocates
+        thread_local Image old_image;
+        thread_local Image new_image;
+        read_image_data(entry_data(old_logo, *old_entry), old_entry->name, old_name, old_image);
+        read_image_data(entry_data(new_logo, *new_entry), new_entry->name, new_name, new_image);
+
+        const auto row_size = old_image.width * 3;
+        diff.left = old_image.width;
+        diff.top = old_image.height;
+        for(std::size_t y = 0; y < old_image.height; ++y)
+        {
+            auto old_row = old_image.row(y);
+            auto new_row = new_image.row(y);
+            if(std::memcmp(old_row, new_row, row_size) == 0)
+                continue;
+
+            for(std::size_t x = 0; x < old_image.width; ++x)
+            {
+                if(std::memcmp(old_row + x * 3, new_row + x * 3, 3) == 0)
+                    continue;
+
+                ++diff.changed_pixels;
+                diff.left = std::min(diff.left, x);
+                diff.right = std::max(diff.right, x + 1);
+            }
+            diff.top = std::min(diff.top, y);
+            diff.bottom = y + 1;
+        }
+
+        if(diff.changed_pixels == 0)
+        {
+            diff.status = Diff_status::reencoded;
+            diff.left = diff.top = 0;
+        }
+        else
+            diff.status = Diff_status::changed;
+    });
+
+    return diffs;
+}
+
+std::size_t max_encoded_size(std::size_t width, std::size_t height)
+{
+    // a literal packet costs 2 + 3 bytes per pixel, and a repeat packet 5 bytes for 3 or more pixels.
+    // Each repeat packet can split a literal packet in two, but saves more than the extra header,
+    // so a row is never larger than all-literal: 3 bytes per pixel, plus a header every 0x0FFF pixels
+    return image_magic_size + 2 * sizeof(std::uint16_t) + height * (3 * width + 2 * ((width + 0x0FFEu) / 0x0FFFu));
+}
+
+namespace
+{
+    constexpr std::size_t max_packet_count = 0x0FFFu;
+
+    // literal pixels are copied straight from the row, swapped to BGR
+    void write_literal(const std::uint8_t * row_data, std::size_t start, std::size_t end, Byte_writer & output)
+    {
+        while(start < end)
+        {
+            auto count = std::min(end - start, max_packet_count);
+            output.write(static_cast<std::uint16_t>(count), std::endian::big);
+            bgr_to_rgb(row_data + start * 3, reinterpret_cast<std::uint8_t *>(std::data(output.next(count * 3))), count);
+            start += count;
+        }
+    }
+
+    void write_repeat(const std::uint8_t * pixel, std::size_t count, Byte_writer & output)
+    {
+        output.write(static_cast<std::uint16_t>(count | 0x8000u), std::endian::big);
+        auto bgr = std::data(output.next(3));
+        bgr[0] = std::byte{pixel[2]};
+        bgr[1] = std::byte{pixel[1]};
+        bgr[2] = std::byte{pixel[0]};
+    }
+
+    void encode_row_greedy(const std::uint8_t * row_data, std::size_t width, Byte_writer & output)
+    {
+        std::size_t literal_start = 0;
+        for(std::size_t col = 0; col < width;)
+        {
+            // most pixels in noisy images don't start a run. Catch those without a call to the run length search
+            auto count = col + 1 < width && std::memcmp(row_data + col * 3, row_data + col * 3 + 3, 3) != 0
+                ? std::size_t{1} : rgb_run_length(row_data + col * 3, std::min(width - col, max_packet_count));
+
+            if(count > 2)
+            {
+                write_literal(row_data, literal_start, col, output);
+                write_repeat(row_data + col * 3, count, output);
+                col += count;
+                literal_start = col;
+            }
+            else
+            {
+                // a run of 1 or 2 is cheaper stored as-is. The pixel following a run of 2 can't start a longer run, so take both
+                col += count;
+            }
+        }
+
+        write_literal(row_data, literal_start, width, output);
+    }
+
+    // working space for encode_row_optimal, kept between rows and images so it's only allocated once per thread
+    struct Optimal_scratch
+    {
+        std::vector<std::uint64_t> cost;
+        std::vector<std::size_t> packet_start;
+        std::vector<std::uint8_t> packet_repeat;
+        std::vector<std::size_t> window;
+        std::vector<std::size_t> packet_ends;
+    };
+
+    // RLE compress one row into the fewest possible bytes.
+    // A repeat packet costs 5 bytes and a literal packet 2 + 3 per pixel, each covering up to 0x0FFF pixels.
+    // cost[i] is the smallest encoding of the first i pixels, which never decreases as i grows, so:
+    //   the best repeat packet ending at i starts as early as possible: at the start of the run, or 0x0FFF pixels back.
+    //   the best literal packet ending at i starts at the j minimizing cost[j] - 3j in the last 0x0FFF pixels,
+    //   found with a sliding window minimum
+    void encode_row_optimal(const std::uint8_t * row_data, std::size_t width, Byte_writer & output, Optimal_scratch & scratch)
+    {
+        constexpr std::uint64_t header_cost = 2u, pixel_cost = 3u;
+
+        auto & cost = scratch.cost;
+        auto & packet_start = scratch.packet_start;
+        auto & packet_repeat = scratch.packet_repeat;
+        auto & window = scratch.window;
+
+        cost.assign(width + 1, 0);
+        packet_start.resize(width + 1);
+        packet_repeat.resize(width + 1);
+        window.resize(width + 1);
+
+        // candidate literal packet starts, with increasing cost[j] - 3j
+        std::size_t window_front = 0, window_back = 0;
+        auto literal_key = [&cost](std::size_t j) { return static_cast<std::int64_t>(cost[j]) - static_cast<std::int64_t>(pixel_cost * j); };
+
+        auto same_pixel = [row_data](std::size_t a, std::size_t b)
+        {
+            return std::memcmp(row_data + a * 3, row_data + b * 3, 3) == 0;
+        };
+
+        std::size_t run_start = 0;
+        for(std::size_t i = 1; i <= width; ++i)
+        {
+            // start of the run of identical pixels that pixel i - 1 is in
+            if(i > 1 && !same_pixel(i - 1, i - 2))
+                run_start = i - 1;
+
+            // j = i - 1 becomes a possible literal start
+            while(window_back > window_front && literal_key(window[window_back - 1]) >= literal_key(i - 1))
+                --window_back;
+            window[window_back++] = i - 1;
+            while(window[window_front] + max_packet_count < i)
+                ++window_front;
+
+            auto literal_j = window[window_front];
+            auto literal_cost = cost[literal_j] + header_cost + pixel_cost * (i - literal_j);
+
+            auto repeat_j = std::max(run_start, i > max_packet_count ? i - max_packet_count : std::size_t{0});
+            auto repeat_cost = cost[repeat_j] + header_cost + pixel_cost;
+
+            if(repeat_cost <= literal_cost)
+            {
+                cost[i] = repeat_cost;
+                packet_start[i] = repeat_j;
+                packet_repeat[i] = true;
+            }
+            else
+            {
+                cost[i] = literal_cost;
+                packet_start[i] = literal_j;
+                packet_repeat[i] = false;
+            }
+        }
+
+        // walk back from the end of the row to find the packets, then write them in order
+        auto & packet_ends = scratch.packet_ends;
+        packet_ends.clear();
+        for(auto i = width; i > 0; i = packet_start[i])
+            packet_ends.push_back(i);
+
+        for(auto end = std::rbegin(packet_ends); end != std::rend(packet_ends); ++end)
+        {
+            auto start = packet_start[*end];
+            if(packet_repeat[*end])
+                write_repeat(row_data + start * 3, *end - start, output);
+            else
+                write_literal(row_data, start, *end, output);
+        }
+    }
+}
+
+namespace
+{
+    // done before anything is sized from the dimensions
+    void check_dimensions(const Image_view & im, const std::string & name)
+    {
+        if(im.width > max_image_dimension || im.height > max_image_dimension)
+            throw std::runtime_error{"Error writing " + name + ": image dimensions are too large (" + std::to_string(im.width) + "x" + std::to_string(im.height) + ")"};
+    }
+
+    std::size_t encode_view(const Image_view & im, std::span<std::byte> output, Rle_mode mode, const std::string & name)
+    {
+        check_dimensions(im, name);
+
+        if(std::size(output) < max_encoded_size(im.width, im.height))
+            throw std::logic_error{"Output buffer too small to encode " + name};
+
+        auto out = Byte_writer{output};
+
+        out.write_str("MotoRun\0"s, image_magic_size);
+        out.write(static_cast<std::uint16_t>(im.width), std::endian::big);
+        out.write(static_cast<std::uint16_t>(im.height), std::endian::big);
+
+        thread_local Optimal_scratch scratch;
+
+        for(auto row = 0u; row < im.height; ++row)
+        {
+            const auto row_data = im.row(row);
+
+            if(mode == Rle_mode::optimal)
+                encode_row_optimal(row_data, im.width, out, scratch);
+            else
+                encode_row_greedy(row_data, im.width, out);
+        }
+
+        return out.position();
+    }
+
+    std::vector<std::byte> encode_view(const Image_view & im, Rle_mode mode, const std::string & name)
+    {
+        check_dimensions(im, name);
+
+        // encode into a buffer big enough for anything, kept between images, then copy out only what was used
+        thread_local std::vector<std::byte> buffer;
+        if(std::size(buffer) < max_encoded_size(im.width, im.height))
+            buffer.resize(max_encoded_size(im.width, im.height));
+
+        auto size = encode_view(im, buffer, mode, name);
+        return std::vector<std::byte>(std::begin(buffer), std::begin(buffer) + size);
+    }
+}
+
+std::size_t encode_image(const Image & im, std::span<std::byte> output, Rle_mode mode)
+{
+    return encode_view(im.view(), output, mode, im.name);
+}
+
+std::vector<std::byte> encode_image(const Image & im, Rle_mode mode)
+{
+    return encode_view(im.view(), mode, im.name);
+}
+
+std::size_t encode_image(const Image_view & im, std::span<std::byte> output, Rle_mode mode)
+{
+    return encode_view(im, output, mode, "image");
+}
+
+std::vector<std::byte> encode_image(const Image_view & im, Rle_mode mode)
+{
+    return encode_view(im, mode, "image");
+}
+
+// strip directory and extension from a filename to get its directory entry name
+std::string entry_name(const std::string & filename)
+{
+    auto dir_end = filename.find_last_of("/\\");
+    auto name_start = dir_end == std::string::npos ? 0u : dir_end + 1;
+
+    auto ext_start = filename.find_last_of('.');
+    if(ext_start == std::string::npos || ext_start < name_start)
+        ext_start = std::size(filename);
+
+    auto name = filename.substr(name_start, ext_start - name_start);
+
+    if(std::size(name) > name_size - 1)
+        throw std::runtime_error{"Error writing " + name + " filename exceeds maximum length(" + std::to_string(name_size - 1) + " characters)"};
+
+    return name;
+}
+
+namespace
+{
+    // sizes and packet counts of a compressed image
+    void blob_stats(std::span<const std::byte> blob, const std::string & name, const std::string & source_name, Entry_stats & stats)
+    {
+        auto header = read_image_header(blob, name, source_name);
+        stats.width = header.width;
+        stats.height = header.height;
+        stats.raw_size = static_cast<std::uint64_t>(header.width) * header.height * 3u;
+        stats.compressed_size = std::size(blob);
+        stats.rle = rle_stats(blob, name, source_name);
+    }
+}
+
+std::vector<std::byte> write_image(const std::string & filename, const Pack_options & options, Blob_cache * cache, Entry_stats * stats)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    auto format = options.input_format.value_or(format_from_extension(filename).value_or(Image_format::png));
+    auto im = read_image(filename, format, options.raw_width, options.raw_height);
+    im.name = filename;
+
+    if(stats)
+        stats->image_seconds = seconds_since(start);
+
+    auto mode = options.rle_mode;
+
+    auto encode = [&]()
+    {
+        start = std::chrono::steady_clock::now();
+        auto blob = encode_image(im, mode);
+        if(stats)
+        {
+            stats->rle_seconds = seconds_since(start);
+            blob_stats(blob, stats->name, filename, *stats);
+        }
+        return blob;
+    };
+
+    if(!cache)
+        return encode();
+
+    start = std::chrono::steady_clock::now();
+    auto key = cache->key(im, mode == Rle_mode::optimal ? "opt" : "");
+    auto cached = cache->find(key, im);
+    if(stats)
+        stats->cache_seconds = seconds_since(start);
+
+    if(cached)
+    {
+        if(stats)
+        {
+            stats->cached = true;
+            blob_stats(*cached, stats->name, filename, *stats);
+        }
+        return *cached;
+    }
+
+    auto blob = encode();
+
+    start = std::chrono::steady_clock::now();
+    cache->store(key, blob);
+    if(stats)
+        stats->cache_seconds += seconds_since(start);
+
+    return blob;
+}
+
+namespace
+{
+    // images are aligned to 512 bytes
+    std::uint64_t align_offset(std::uint64_t offset)
+    {
+        auto diff = 512u - (offset % 512u);
+        return offset + (diff == 512u ? 0u : diff);
+    }
+
+    void check_entry_name(const std::string & name)
+    {
+        if(std::size(name) > name_size - 1)
+            throw std::runtime_error{"Error writing " + name + " filename exceeds maximum length(" + std::to_string(name_size - 1) + " characters)"};
+    }
+
+    // check that an image fits, and return its entry
+    Logo_entry place_image(const std::string & name, std::size_t size, std::uint64_t & file_size)
+    {
+        check_entry_name(name);
+
+        if(size > std::numeric_limits<std::uint32_t>::max())
+            throw std::runtime_error{"Error writing " + name + " compressed image size is too large"};
+
+        if(file_size + size > std::numeric_limits<std::uint32_t>::max())
+            throw std::runtime_error{"Error writing " + name + " total image size is too large"};
+
+        file_size = align_offset(file_size);
+        auto entry = Logo_entry{name, static_cast<std::uint32_t>(file_size), static_cast<std::uint32_t>(size)};
+        file_size += size;
+
+        return entry;
+    }
+
+    // output needs directory_size(std::size(entries)) bytes
+    void write_directory(const std::vector<Logo_entry> & entries, Byte_writer & output)
+    {
+        output.write_str("MotoLogo\0"s, magic_size);
+        output.write(directory_size(std::size(entries)), std::endian::little);
+
+        for(auto && entry: entries)
+        {
+            output.write_str(entry.name, name_size);
+            output.write(entry.offset, std::endian::little);
+            output.write(entry.size, std::endian::little);
+        }
+    }
+}
+
+std::vector<std::byte> build_logo(const std::vector<Logo_image> & images)
+{
+    // lay out each image, aligned to 512 bytes
+    std::vector<Logo_entry> entries;
+    std::uint64_t file_size = directory_size(std::size(images));
+    for(auto && image: images)
+        entries.push_back(place_image(image.name, std::size(image.data), file_size));
+
+    std::vector<std::byte> data(file_size, std::byte{0xFF});
+    auto output = Byte_writer{data};
+
+    write_directory(entries, output);
+
+    for(auto i = 0u; i < std::size(images); ++i)
+        std::copy(std::begin(images[i].data), std::end(images[i].data), std::begin(data) + entries[i].offset);
+
+    return data;
+}
+
+namespace
+{
+    // a symlinked output is written through to the file it points at, rather than being replaced
+    std::string resolve_output(const std::string & filename)
+    {
+        std::error_code ec;
+        if(!std::filesystem::is_symlink(filename, ec))
+            return filename;
+
+        auto target = std::filesystem::weakly_canonical(filename, ec);
+        return ec ? filename : target.string();
+    }
+
+    // create an empty file next to filename, with a name no other writer can be using
+    std::string make_temp_file(const std::string & filename)
+    {
+#ifdef HAS_MKSTEMP
+        auto name = filename + ".XXXXXX";
+        auto fd = mkstemp(std::data(name));
+        if(fd < 0)
+            throw std::runtime_error{"Could not create temp file for: " + filename + ". " + std::strerror(errno)};
+        close(fd);
+        return name;
+#else
+        std::random_device rng;
+        for(auto tries = 0; tries < 100; ++tries)
+        {
+            auto name = filename + "." + std::to_string(rng()) + ".tmp";
+            if(std::error_code ec; !std::filesystem::exists(name, ec) && !ec)
+                return name;
+        }
+        throw std::runtime_error{"Could not create temp file for: " + filename};
+#endif
+    }
+
+    // give the temp file the output's permissions, or the usual ones for a new file
+    void copy_permissions(const std::string & tmp_filename, const std::string & filename)
+    {
+        std::error_code ec;
+        if(auto status = std::filesystem::status(filename, ec); !ec && std::filesystem::exists(status))
+        {
+            std::filesystem::permissions(tmp_filename, status.permissions(), ec);
+            return;
+        }
+
+#ifdef HAS_MKSTEMP
+        // mkstemp creates files only the owner can read. A new file should get the same mode as any other
+        auto mask = umask(0);
+        umask(mask);
+        std::filesystem::permissions(tmp_filename, static_cast<std::filesystem::perms>(0666 & ~mask), ec);
+#endif
+    }
+}
+
+Logo_writer::Logo_writer(const std::string & filename, std::size_t num_images, bool dedup):
+    filename_{resolve_output(filename)},
+    tmp_filename_{make_temp_file(filename_)},
+    num_images_{num_images},
+    file_size_{directory_size(num_images)},
+    dedup_{dedup}
+{
+    // opened for reading too, so images can be read back to check for duplicates
+    file_.open(tmp_filename_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!file_)
+    {
+        auto error = std::string{std::strerror(errno)};
+        std::remove(tmp_filename_.c_str());
+        throw std::runtime_error{"Could not open output file: " + tmp_filename_ + ". " + error};
+    }
+
+    // reserve space for the directory
+    const std::vector<char> header(file_size_, '\xFF');
+    file_.write(std::data(header), std::size(header));
+}
+
+Logo_writer::~Logo_writer()
+{
+    if(!finished_)
+    {
+        file_.close();
+        std::remove(tmp_filename_.c_str());
+    }
+}
+
+bool Logo_writer::add(const std::string & name, std::span<const std::byte> data)
+{
+    if(std::size(entries_) == num_images_)
+        throw std::logic_error{"Too many images added to " + filename_};
+
+    std::uint64_t hash = 0;
+    if(dedup_)
+    {
+        // a matching hash is checked byte for byte, so a collision can't corrupt the output
+        hash = hash_bytes(data);
+        auto [first, last] = stored_.equal_range(hash);
+        for(auto stored = first; stored != last; ++stored)
+        {
+            if(entries_[stored->second].size == std::size(data) && stored_equal(entries_[stored->second], data))
+            {
+                add_alias(name, stored->second);
+                return true;
+            }
+        }
+    }
+
+    static const std::array<char, 512> padding = []{ std::array<char, 512> p; p.fill('\xFF'); return p; }();
+
+    auto pos = file_size_;
+    entries_.push_back(place_image(name, std::size(data), file_size_));
+
+    file_.write(std::data(padding), entries_.back().offset - pos);
+    file_.write(reinterpret_cast<const char *>(std::data(data)), std::size(data));
+
+    if(!file_)
+        throw std::runtime_error{"Error writing " + tmp_filename_ + ". " + std::strerror(errno)};
+
+    if(dedup_)
+        stored_.emplace(hash, std::size(entries_) - 1);
+
+    return false;
+}
+
+void Logo_writer::add_alias(const std::string & name, std::size_t index)
+{
+    if(std::size(entries_) == num_images_)
+        throw std::logic_error{"Too many images added to " + filename_};
+    if(index >= std::size(entries_))
+        throw std::logic_error{"Image shared before it was added to " + filename_};
+
+    check_entry_name(name);
+
+    entries_.push_back({name, entries_[index].offset, entries_[index].size});
+}
+
+bool Logo_writer::stored_equal(const Logo_entry & entry, std::span<const std::byte> data)
+{
+    std::vector<std::byte> stored(entry.size);
+
+    file_.seekg(entry.offset);
+    file_.read(reinterpret_cast<char *>(std::data(stored)), std::size(stored));
+    file_.seekp(file_size_);
+
+    if(!file_)
+        throw std::runtime_error{"Error reading back " + tmp_filename_ + ". " + std::strerror(errno)};
+
+    return std::equal(std::begin(stored), std::end(stored), std::begin(data), std::end(data));
+}
+
+void Logo_writer::finish()
+{
+    if(std::size(entries_) != num_images_)
+        throw std::logic_error{"Not enough images added to " + filename_};
+
+    std::vector<std::byte> header(directory_size(std::size(entries_)));
+    auto output = Byte_writer{header};
+    write_directory(entries_, output);
+
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char *>(std::data(header)), std::size(header));
+    file_.close();
+
+    if(!file_)
+        throw std::runtime_error{"Error writing " + tmp_filename_ + ". " + std::strerror(errno)};
+
+    copy_permissions(tmp_filename_, filename_);
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_filename_, filename_, ec);
+    if(ec)
+        throw std::runtime_error{"Could not rename " + tmp_filename_ + " to " + filename_ + ". " + ec.message()};
+
+    finished_ = true;
+}
+
+void write_logo(const std::vector<std::string> & filenames, const std::string & output_filename, const Pack_options & options)
+{
+    // each image in the output either comes from an existing file, or is compressed from one of the inputs
+    struct Slot
+    {
+        std::string name;
+        std::span<const std::byte> existing;
+        std::optional<std::size_t> input;
+        std::optional<std::size_t> same_as; // an earlier slot whose input file is identical
+    };
+    std::vector<Slot> slots;
+
+    auto stats = options.stats;
+    if(stats)
+    {
+        *stats = {};
+        stats->filename = output_filename;
+    }
+
+    auto update_file = std::optional<Mapped_file>{};
+    if(!std::empty(options.update_filename))
+    {
+        auto start = std::chrono::steady_clock::now();
+        update_file.emplace(options.update_filename);
+        if(stats)
+        {
+            stats->read_seconds = seconds_since(start);
+            start = std::chrono::steady_clock::now();
+        }
+
+        for(auto && entry: parse_directory(update_file->data(), options.update_filename))
+            slots.push_back({entry.name, entry_data(update_file->data(), entry), {}});
+
+        if(stats)
+            stats->parse_seconds = seconds_since(start);
+    }
+
+
+    for(auto i = 0u; i < std::size(filenames); ++i)
+    {
+        auto name = entry_name(filenames[i]);
+
+        // new names added by earlier inputs are searched too, so a name given twice fails whether or not it's already in the file
+        auto existing = std::find_if(std::begin(slots), std::end(slots), [&name](const auto & slot) { return slot.name == name; });
+
+        if(existing == std::end(slots))
+            slots.push_back({name, {}, i});
+        else if(existing->input)
+            throw std::runtime_error{"Error writing " + name + ": given more than once"};
+        else
+            existing->input = i;
+    }
+
+    if(options.dedup)
+    {
+        // identical input files are only read and compressed once. Files are hashed in parallel,
+        // then matched up in order, so which slot keeps the data doesn't depend on the number of threads.
+        // Only regular files are hashed: reading a pipe here would leave nothing for write_image.
+        // The rest still share data through Logo_writer, if their compressed images are identical
+        std::vector<std::optional<std::uint64_t>> hashes(std::size(slots));
+        parallel_for(std::size(slots), options.num_threads, [&slots, &filenames, &hashes](std::size_t i)
+        {
+            if(!slots[i].input)
+                return;
+
+            std::error_code ec;
+            if(!std::filesystem::is_regular_file(filenames[*slots[i].input], ec))
+                return;
+
+            // each file is only mapped while it's hashed, so they aren't all held at once
+            try
+            {
+                hashes[i] = hash_bytes(Mapped_file{filenames[*slots[i].input]}.data());
+            }
+            catch(const std::runtime_error &) {} // left for write_image to report
+        });
+
+        // files with matching hashes are compared byte for byte, mapping just the two of them
+        auto same_file = [](const std::string & a, const std::string & b)
+        {
+            try
+            {
+                auto file_a = Mapped_file{a};
+                auto file_b = Mapped_file{b};
+                auto data_a = file_a.data();
+                auto data_b = file_b.data();
+                return std::equal(std::begin(data_a), std::end(data_a), std::begin(data_b), std::end(data_b));
+            }
+            catch(const std::runtime_error &)
+            {
+                return false;
+            }
+        };
+
+        std::unordered_multimap<std::uint64_t, std::size_t> first_slots;
+        for(std::size_t i = 0; i < std::size(slots); ++i)
+        {
+            if(!hashes[i])
+                continue;
+
+            auto [first, last] = first_slots.equal_range(*hashes[i]);
+            auto match = std::find_if(first, last, [&](const auto & slot)
+                { return same_file(filenames[*slots[slot.second].input], filenames[*slots[i].input]); });
+            if(match != last)
+                slots[i].same_as = match->second;
+            else
+                first_slots.emplace(*hashes[i], i);
+        }
+    }
+
+    auto cache = std::optional<Blob_cache>{};
+    if(!std::empty(options.cache_dir))
+        cache.emplace(options.cache_dir);
+
+    if(stats)
+    {
+        stats->entries.resize(std::size(slots));
+        for(std::size_t i = 0; i < std::size(slots); ++i)
+            stats->entries[i].name = slots[i].name;
+    }
+
+    // images are loaded and compressed in parallel, then streamed out in order, so only a few are in memory at once.
+    // the output is written to a temp file, so it's safe to update a file in-place
+    auto start = std::chrono::steady_clock::now();
+    Logo_writer writer{output_filename, std::size(slots), options.dedup};
+    auto write_seconds = seconds_since(start);
+
+    parallel_ordered(std::size(slots), options.num_threads,
+        [&slots, &filenames, &options, &cache, stats](std::size_t i)
+        {
+            if(!slots[i].input || slots[i].same_as)
+                return std::vector<std::byte>{};
+            return write_image(filenames[*slots[i].input], options, cache ? &*cache : nullptr, stats ? &stats->entries[i] : nullptr);
+        },
+        [&slots, &writer, &options, stats](std::size_t i, std::vector<std::byte> && data)
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto shared = true;
+            if(slots[i].same_as)
+                writer.add_alias(slots[i].name, *slots[i].same_as);
+            else if(slots[i].input)
+                shared = writer.add(slots[i].name, data);
+            else
+                shared = writer.add(slots[i].name, slots[i].existing);
+
+            if(stats)
+            {
+                if(slots[i].same_as)
+                {
+                    // nothing was read or compressed, so only the sizes carry over
+                    auto & entry = stats->entries[i];
+                    entry = stats->entries[*slots[i].same_as];
+                    entry.name = slots[i].name;
+                    entry.image_seconds = entry.rle_seconds = entry.cache_seconds = 0.0;
+                    entry.kept = entry.cached = false;
+                }
+                stats->entries[i].shared = shared;
+                stats->entries[i].write_seconds = seconds_since(start);
+                if(!slots[i].input)
+                {
+                    // kept images are copied without being checked, so a bad one only leaves its stats incomplete
+                    stats->entries[i].kept = true;
+                    stats->entries[i].compressed_size = std::size(slots[i].existing);
+                    try
+                    {
+                        blob_stats(slots[i].existing, slots[i].name, options.update_filename, stats->entries[i]);
+                    }
+                    catch(const std::runtime_error &) {}
+                }
+            }
+
+            if(!options.progress)
+                return;
+            if(shared)
+            {
+                auto && entries = writer.entries();
+                auto original = std::find_if(std::begin(entries), std::end(entries), [&added = entries.back()](const auto & entry)
+                    { return entry.offset == added.offset && entry.size == added.size; });
+                *options.progress<<"Shared "<<slots[i].name<<" with "<<original->name<<'\n';
+            }
+            else
+                *options.progress<<(slots[i].input ? "Wrote " : "Kept ")<<slots[i].name<<'\n';
+        });
+
+    start = std::chrono::steady_clock::now();
+    writer.finish();
+
+    if(stats)
+    {
+        stats->write_seconds = write_seconds + seconds_since(start);
+        stats->file_size = writer.size();
+        padding_stats(writer.entries(), writer.entries(), *stats);
+
+        // the padding after a shared image belongs to the entry that stored it
+        for(auto && entry: stats->entries)
+        {
+            if(entry.shared)
+                entry.padding = 0;
+        }
     }
 
-    std::ofstream{output_filename, std::ios::binary}.write(reinterpret_cast<const char *>(std::data(data)), std::size(data));
+    if(cache && options.progress)
+        *options.progress<<"Cache: "<<cache->hits()<<" hits, "<<cache->misses()<<" misses\n";
 }
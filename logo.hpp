@@ -1,9 +1,254 @@
 #ifndef LOGO_HPP
 #define LOGO_HPP
 
+#include <compare>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-void read_logo(const std::string & input_filename);
-void write_logo(const std::vector<std::string> & filenames, const std::string & output_filename);
+#include <cstddef>
+#include <cstdint>
+
+#include "formats.hpp"
+#include "image.hpp"
+#include "png.hpp"
+#include "stats.hpp"
+
+// one directory entry from a logo.bin file
+struct Logo_entry
+{
+    std::string name;
+    std::uint32_t offset {0}; // from the start of the file
+    std::uint32_t size {0};
+};
+
+// a named, RLE compressed MotoRun image, ready to be packed into a logo.bin file
+struct Logo_image
+{
+    std::string name;
+    std::vector<std::byte> data;
+};
+
+// in-memory API. source_name is only used for error messages
+
+// parse and validate the directory of a logo.bin file
+std::vector<Logo_entry> parse_directory(std::span<const std::byte> logo, const std::string & source_name = "logo.bin");
+// the compressed MotoRun data for a directory entry
+std::span<const std::byte> entry_data(std::span<const std::byte> logo, const Logo_entry & entry);
+// decode a directory entry into an RGB image. The image is named after the entry
+Image decode_image(std::span<const std::byte> logo, const Logo_entry & entry, const std::string & source_name = "logo.bin");
+struct Image_header
+{
+    std::size_t width {0};
+    std::size_t height {0};
+};
+
+// check a MotoRun image's identifier and get its dimensions
+Image_header read_image_header(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name);
+// decode a single MotoRun image
+Image read_image_data(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name);
+// decode into an existing image, reusing its buffer when it's big enough. See Image::set_size for row_alignment
+void read_image_data(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name, Image & im, std::size_t row_alignment = 0);
+// decode a single MotoRun image one row at a time. row_func is called with each row of width * 3 RGB bytes, top to bottom
+void read_image_rows(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name, const std::function<void(const std::uint8_t *)> & row_func);
+// count a MotoRun image's packets without decoding it
+Rle_stats rle_stats(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name);
+
+// transforms that work on a MotoRun image's packets directly, without decoding it.
+// Their cost depends on the number of packets, not pixels, except where literal pixels have to be checked one by one
+struct Rgb
+{
+    std::uint8_t r {0};
+    std::uint8_t g {0};
+    std::uint8_t b {0};
+
+    auto operator<=>(const Rgb &) const = default;
+};
+
+// every color in a MotoRun image, with its number of pixels, most common first
+std::vector<std::pair<Rgb, std::uint64_t>> color_histogram(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name);
+// replace every pixel of one color with another, in both repeat and literal packets.
+// Packets are patched in place, so the result is the same size as the input, and may no longer be optimally compressed
+std::vector<std::byte> recolor_image(const std::span<const std::byte> & data, Rgb from, Rgb to, const std::string & name, const std::string & source_name);
+// keep num_rows rows, starting from first_row. Packets crossing the edges of the crop are split. The rest are copied unchanged
+std::vector<std::byte> crop_image_rows(const std::span<const std::byte> & data, std::size_t first_row, std::size_t num_rows, const std::string & name, const std::string & source_name);
+
+// same as read_image_data, but checks every byte read and written individually. Slow, but simple enough to validate against
+Image read_image_data_reference(const std::span<const std::byte> & data, const std::string & name, const std::string & source_name);
+enum class Rle_mode
+{
+    greedy, // fast. Any run of 3 or more pixels becomes a repeat packet
+    optimal // smallest possible output, at a few times the cost
+};
+
+// RLE compress an image into a MotoRun image
+std::vector<std::byte> encode_image(const Image & im, Rle_mode mode = Rle_mode::greedy);
+// largest possible MotoRun image of the given dimensions
+std::size_t max_encoded_size(std::size_t width, std::size_t height);
+// RLE compress into a caller supplied buffer of at least max_encoded_size bytes, so nothing is allocated. Returns the size written
+std::size_t encode_image(const Image & im, std::span<std::byte> output, Rle_mode mode = Rle_mode::greedy);
+// the same, for pixels owned by someone else. Rows may be padded
+std::vector<std::byte> encode_image(const Image_view & im, Rle_mode mode = Rle_mode::greedy);
+std::size_t encode_image(const Image_view & im, std::span<std::byte> output, Rle_mode mode = Rle_mode::greedy);
+// build a complete logo.bin file, in the given order
+std::vector<std::byte> build_logo(const std::vector<Logo_image> & images);
+
+// shell-style wildcard match. '*' matches any number of characters, '?' matches any single character
+bool glob_match(std::string_view pattern, std::string_view name);
+// entries whose names match any of the patterns, in directory order. Throws if a pattern doesn't match anything
+std::vector<Logo_entry> select_entries(const std::vector<Logo_entry> & entries, const std::vector<std::string> & patterns, const std::string & source_name = "logo.bin");
+
+// writes a logo.bin file one image at a time, so images don't need to be held in memory.
+// Space for the directory is reserved first and filled in by finish(). Until then, the file is written
+// under a temporary name, so a failure never leaves a partial file in place of the output.
+// With dedup, an image identical to one already added isn't stored again. Its entry points at the earlier copy instead
+class Logo_writer
+{
+public:
+    Logo_writer(const std::string & filename, std::size_t num_images, bool dedup = true);
+    ~Logo_writer();
+
+    Logo_writer(const Logo_writer &) = delete;
+    Logo_writer & operator=(const Logo_writer &) = delete;
+
+    // add the next compressed MotoRun image. Returns true when it was identical to an earlier image, and shares its data
+    bool add(const std::string & name, std::span<const std::byte> data);
+    // add the next entry, sharing the data of the already added entry at index
+    void add_alias(const std::string & name, std::size_t index);
+    // write the directory and move the file into place. All num_images images must have been added
+    void finish();
+
+    // entries added so far, and the current size of the file
+    const std::vector<Logo_entry> & entries() const { return entries_; }
+    std::uint64_t size() const { return file_size_; }
+
+private:
+    // compare data to an image already written, by reading it back
+    bool stored_equal(const Logo_entry & entry, std::span<const std::byte> data);
+
+    std::string filename_;
+    std::string tmp_filename_;
+    std::fstream file_;
+    std::size_t num_images_;
+    std::uint64_t file_size_;
+    std::vector<Logo_entry> entries_;
+    bool dedup_;
+    std::unordered_multimap<std::uint64_t, std::size_t> stored_; // hash of each stored image's data, to its entry
+    bool finished_ {false};
+};
+
+// directory entry name for an image file: the filename without its path or extension
+std::string entry_name(const std::string & filename);
+
+struct Extract_options
+{
+    unsigned int num_threads {1}; // 0 uses all available cores
+    std::vector<std::string> only; // entry names or glob patterns to extract. Extract everything when empty
+    Image_format format {Image_format::png};
+    Png_options png_options; // only used for PNG output
+    std::string output_dir; // directory to write images to, created if needed. The current directory when empty
+    std::vector<Logo_stats> * stats {nullptr}; // when set, filled with one Logo_stats per input, even if extraction fails
+    std::ostream * progress {&std::cout}; // where each extracted image is reported. Nothing is printed when null
+};
+
+// one input for read_logos
+struct Extract_job
+{
+    std::string input_filename;
+    std::string output_dir; // the current directory when empty
+};
+
+struct Pack_options
+{
+    unsigned int num_threads {1}; // 0 uses all available cores
+    // existing logo.bin to update. Its entries are kept as-is, in order, unless replaced by an input with the same name.
+    // Inputs with new names are added to the end
+    std::string update_filename;
+    // directory to cache compressed images in, keyed by their pixel content. Images already in the cache aren't re-compressed
+    std::string cache_dir;
+    Rle_mode rle_mode {Rle_mode::greedy};
+    // format of the input images. Guessed from each filename's extension when not set, falling back to PNG
+    std::optional<Image_format> input_format;
+    // size of raw input images, which have no header to read it from
+    std::size_t raw_width {0};
+    std::size_t raw_height {0};
+    // inputs with identical files, or identical compressed data, share one copy in the output.
+    // Identical regular files are only read and compressed once
+    bool dedup {true};
+    Logo_stats * stats {nullptr}; // filled in when set
+    std::ostream * progress {&std::cout}; // where each written image and the cache totals are reported. Nothing is printed when null
+};
+
+// file based API, used by logo2png and png2logo
+void read_logo(const std::string & input_filename, const Extract_options & options = {});
+// extract many logo.bin files, with all of their images sharing one pool of options.num_threads workers.
+// Each job's output_dir is used in place of options.output_dir.
+// A failed input doesn't stop the rest. Each failure is reported on stderr, then an exception is thrown once everything is done
+void read_logos(const std::vector<Extract_job> & jobs, const Extract_options & options = {});
+
+struct Verify_options
+{
+    unsigned int num_threads {1}; // 0 uses all available cores
+    std::vector<std::string> only; // entry names or glob patterns to verify. Verify everything when empty
+    bool hash {false}; // hash each image's decoded pixels
+};
+
+struct Verify_result
+{
+    std::string name;
+    std::size_t width {0};
+    std::size_t height {0};
+    std::uint64_t hash {0}; // of the decoded RGB pixels, when requested
+    std::string error; // empty when the image is good
+};
+
+// check a logo.bin file without writing anything. Every image is decoded to check that it's well formed and has all of its pixels,
+// and no image may partially overlap another (identical offsets and sizes are allowed, for shared images).
+// Problems are reported per image. Only throws when the file or its directory can't be read
+std::vector<Verify_result> verify_logo(std::span<const std::byte> logo, const std::string & source_name, const Verify_options & options = {});
+std::vector<Verify_result> verify_logo(const std::string & input_filename, const Verify_options & options = {});
+
+enum class Diff_status
+{
+    same,      // identical compressed data. Not decoded
+    reencoded, // different compressed data, but the same pixels
+    changed,   // same dimensions, different pixels
+    resized,   // different dimensions
+    added,     // only in the new file
+    removed    // only in the old file
+};
+
+// one entry of diff_logos. Entries are matched up by name
+struct Entry_diff
+{
+    std::string name;
+    Diff_status status {Diff_status::same};
+
+    Image_header old_header;
+    Image_header new_header;
+    std::uint64_t old_hash {0}; // of the compressed data
+    std::uint64_t new_hash {0};
+
+    // for changed images: the number of pixels that differ, and the smallest rectangle containing them
+    std::uint64_t changed_pixels {0};
+    std::size_t left {0};
+    std::size_t top {0};
+    std::size_t right {0}; // exclusive
+    std::size_t bottom {0}; // exclusive
+};
+
+// compare two logo.bin files. Entries with identical compressed data are found by hash, without decoding.
+// Only the rest are decoded and compared pixel by pixel.
+// Results are in the old file's directory order, followed by added entries in the new file's order
+std::vector<Entry_diff> diff_logos(std::span<const std::byte> old_logo, const std::string & old_name,
+    std::span<const std::byte> new_logo, const std::string & new_name, unsigned int num_threads = 1);
+void write_logo(const std::vector<std::string> & filenames, const std::string & output_filename, const Pack_options & options = {});
+
 #endif // LOGO_HPP
@@ -1,29 +1,78 @@
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <cxxopts.hpp>
 
+#include "formats.hpp"
+#include "hash.hpp"
 #include "png.hpp"
 #include "logo.hpp"
+#include "stats.hpp"
 
 struct Args
 {
-    std::string input_filename;
+    std::vector<Extract_job> jobs;
+    bool batch {false};
+    Extract_options extract_options;
+    bool stats {false};
+    std::string stats_json;
+    bool verify {false};
+    bool hash {false};
 };
 
+// each line is an input filename, optionally followed by a tab and its output directory. Blank lines and lines starting with # are skipped
+std::vector<Extract_job> read_manifest(const std::string & filename)
+{
+    std::ifstream manifest{filename};
+    if(!manifest)
+        throw std::runtime_error{"Could not open manifest: " + filename};
+
+    std::vector<Extract_job> jobs;
+    for(std::string line; std::getline(manifest, line);)
+    {
+        if(!std::empty(line) && line.back() == '\r')
+            line.pop_back();
+
+        if(std::empty(line) || line.front() == '#')
+            continue;
+
+        if(auto tab = line.find('\t'); tab != std::string::npos)
+            jobs.push_back({line.substr(0, tab), line.substr(tab + 1)});
+        else
+            jobs.push_back({line, {}});
+    }
+
+    return jobs;
+}
+
 std::optional<Args> get_args(int argc, char * argv[])
 {
-    cxxopts::Options options{argv[0], "Unpack a Moto logo.bin file into PNGs"};
+    cxxopts::Options options{argv[0], "Unpack a Moto logo.bin file into PNGs, or other image formats"};
 
     try
     {
         options.add_options()
             ("h,help",   "Show this message and quit")
-            ("input",    "Input filename", cxxopts::value<std::string>());
+            ("j,jobs",   "Number of images to extract in parallel. 0 uses all available cores", cxxopts::value<unsigned int>()->default_value("1"), "N")
+            ("format",   "Output image format: png, ppm, bmp, or raw (packed RGB, with no header). Uncompressed formats are much faster to write", cxxopts::value<std::string>()->default_value("png"), "FORMAT")
+            ("png-level", "PNG compression level: 0 - 9, default, or fast (level 1 with no filtering)", cxxopts::value<std::string>()->default_value("default"), "LEVEL")
+            ("png-filter", "PNG row filter: none, sub, up, avg, paeth, all, or default", cxxopts::value<std::string>()->default_value("default"), "FILTER")
+            ("only",     "Only extract these entries. Comma separated list of names, which may use * and ? wildcards", cxxopts::value<std::vector<std::string>>(), "NAME[,NAME...]")
+            ("d,output-dir", "Directory to write images to. In batch mode, each input's directory is created under this one", cxxopts::value<std::string>(), "DIR")
+            ("manifest", "Batch mode: extract every input listed in FILE, one per line. A tab and an output directory may follow each filename", cxxopts::value<std::string>(), "FILE")
+            ("verify",   "Decode and check every image without writing any files. Exits with an error if any image is bad")
+            ("hash",     "With --verify, print a hash of each image's decoded pixels")
+            ("stats",    "Print sizes, RLE packet counts and time spent in each phase, for every image")
+            ("stats-json", "Write the same statistics as --stats to FILE as JSON. - writes to stdout", cxxopts::value<std::string>(), "FILE")
+            ("input",    "Input filenames. Giving more than one enables batch mode", cxxopts::value<std::vector<std::string>>());
 
         options.parse_positional({"input"});
-        options.positional_help("LOGO.BIN");
+        options.positional_help("LOGO.BIN [LOGO.BIN...]");
 
         auto args = options.parse(argc, argv);
 
@@ -34,7 +83,91 @@ std::optional<Args> get_args(int argc, char * argv[])
         }
 
         Args output_args;
-        output_args.input_filename = args["input"].as<std::string>();
+        if(args.count("input"))
+        {
+            for(auto && input: args["input"].as<std::vector<std::string>>())
+                output_args.jobs.push_back({input, {}});
+        }
+        if(args.count("manifest"))
+        {
+            try
+            {
+                auto manifest_jobs = read_manifest(args["manifest"].as<std::string>());
+                output_args.jobs.insert(std::end(output_args.jobs), std::begin(manifest_jobs), std::end(manifest_jobs));
+            }
+            catch(const std::runtime_error & e)
+            {
+                throw cxxopts::OptionException{e.what()};
+            }
+            output_args.batch = true;
+        }
+        if(std::empty(output_args.jobs))
+            throw cxxopts::OptionException{"No input files given"};
+        if(std::size(output_args.jobs) > 1)
+            output_args.batch = true;
+
+        // resolves . and .., symlinks, and relative paths, so different names for the same place are caught
+        auto same_place = [](const std::filesystem::path & path)
+        {
+            std::error_code ec;
+            auto canonical = std::filesystem::weakly_canonical(path, ec);
+            return ec ? std::filesystem::absolute(path).lexically_normal() : canonical;
+        };
+
+        auto output_dir = args.count("output-dir") ? args["output-dir"].as<std::string>() : std::string{};
+        if(!output_args.batch)
+            output_args.extract_options.output_dir = output_dir;
+        else
+        {
+            // by default each input gets its own directory named after it, so inputs that all have the same entry names don't collide
+            std::set<std::filesystem::path> inputs;
+            std::set<std::filesystem::path> output_dirs;
+            for(auto && job: output_args.jobs)
+            {
+                if(!inputs.insert(same_place(job.input_filename)).second)
+                    throw cxxopts::OptionException{"Input given more than once: " + job.input_filename};
+
+                auto dir = std::filesystem::path{job.output_dir};
+                if(std::empty(dir))
+                {
+                    dir = std::filesystem::path{job.input_filename}.replace_extension();
+                    if(!std::empty(output_dir))
+                        dir = dir.relative_path();
+                }
+                if(!std::empty(output_dir))
+                    dir = std::filesystem::path{output_dir} / dir;
+
+                dir = dir.lexically_normal();
+                if(!output_dirs.insert(same_place(dir)).second)
+                    throw cxxopts::OptionException{"More than one input would be extracted to " + dir.string()};
+
+                job.output_dir = dir.string();
+            }
+        }
+
+        output_args.extract_options.num_threads = args["jobs"].as<unsigned int>();
+        try
+        {
+            output_args.extract_options.format = parse_image_format(args["format"].as<std::string>());
+            parse_png_filter(args["png-filter"].as<std::string>(), output_args.extract_options.png_options);
+            parse_png_level(args["png-level"].as<std::string>(), output_args.extract_options.png_options);
+        }
+        catch(const std::runtime_error & e)
+        {
+            throw cxxopts::OptionException{e.what()};
+        }
+
+        output_args.verify = args.count("verify");
+        output_args.hash = args.count("hash");
+        if(output_args.hash && !output_args.verify)
+            throw cxxopts::OptionException{"--hash requires --verify"};
+
+        output_args.stats = args.count("stats");
+        if(args.count("stats-json"))
+            output_args.stats_json = args["stats-json"].as<std::string>();
+
+        if(args.count("only"))
+            output_args.extract_options.only = args["only"].as<std::vector<std::string>>();
 
         return output_args;
     }
@@ -45,21 +178,101 @@ std::optional<Args> get_args(int argc, char * argv[])
     }
 }
 
+// returns false if any image is bad
+bool verify(const Args & args)
+{
+    Verify_options options;
+    options.num_threads = args.extract_options.num_threads;
+    options.only = args.extract_options.only;
+    options.hash = args.hash;
+
+    auto all_good = true;
+    for(auto && job: args.jobs)
+    {
+        auto results = std::vector<Verify_result>{};
+        try
+        {
+            results = verify_logo(job.input_filename, options);
+        }
+        catch(const std::runtime_error & e)
+        {
+            std::cerr<<"Bad: "<<job.input_filename<<": "<<e.what()<<'\n';
+            all_good = false;
+            continue;
+        }
+
+        auto num_bad = 0u;
+        for(auto && result: results)
+        {
+            if(!std::empty(result.error))
+            {
+                ++num_bad;
+                std::cerr<<"Bad: "<<(args.batch ? job.input_filename + ": " : "")<<result.name<<": "<<result.error<<'\n';
+                continue;
+            }
+
+            std::cout<<"OK: "<<(args.batch ? job.input_filename + ": " : "")<<result.name<<" ("<<result.width<<"x"<<result.height<<")";
+            if(args.hash)
+                std::cout<<' '<<hash_to_string(result.hash);
+            std::cout<<'\n';
+        }
+
+        if(num_bad > 0)
+        {
+            std::cerr<<job.input_filename<<": "<<num_bad<<" of "<<std::size(results)<<" images bad\n";
+            all_good = false;
+        }
+        else
+            std::cout<<job.input_filename<<": "<<std::size(results)<<" images OK\n";
+    }
+
+    return all_good;
+}
+
 int main(int argc, char * argv[])
 {
     auto args = get_args(argc, argv);
     if(!args)
         return EXIT_FAILURE;
 
+    if(args->verify)
+        return verify(*args) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    std::vector<Logo_stats> stats;
+    if(args->stats || !std::empty(args->stats_json))
+        args->extract_options.stats = &stats;
+
+    // keep stdout clean when JSON is written there, so it can be parsed
+    auto & messages = args->stats_json == "-" ? std::cerr : std::cout;
+    args->extract_options.progress = &messages;
+
+    auto result = EXIT_SUCCESS;
     try
     {
-        read_logo(args->input_filename);
+        if(args->batch)
+            read_logos(args->jobs, args->extract_options);
+        else
+            read_logo(args->jobs.front().input_filename, args->extract_options);
     }
     catch(const std::runtime_error & e)
     {
         std::cerr<<e.what()<<'\n';
-        return EXIT_FAILURE;
+        result = EXIT_FAILURE;
+    }
+
+    // in batch mode, the inputs that did succeed are still worth reporting
+    try
+    {
+        if(args->stats)
+            print_stats(messages, stats);
+        if(!std::empty(args->stats_json))
+            write_stats_json(args->stats_json, stats);
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        result = EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return result;
 }
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "hash.hpp"
+#include "logo.hpp"
+#include "mapped_file.hpp"
+
+// same as diff(1)
+constexpr auto exit_same = 0;
+constexpr auto exit_different = 1;
+constexpr auto exit_trouble = 2;
+
+struct Args
+{
+    std::string old_filename;
+    std::string new_filename;
+    unsigned int num_threads {1};
+    bool all {false};
+    bool hashes {false};
+};
+
+std::optional<Args> get_args(int argc, char * argv[])
+{
+    cxxopts::Options options{argv[0], "Show which images differ between two Moto logo.bin files"};
+
+    try
+    {
+        options.add_options()
+            ("h,help",   "Show this message and quit")
+            ("j,jobs",   "Number of images to compare in parallel. 0 uses all available cores", cxxopts::value<unsigned int>()->default_value("1"), "N")
+            ("a,all",    "Also list images that are the same")
+            ("hashes",   "Print the hashes of each image's compressed data")
+            ("input",    "Old and new logo.bin filenames", cxxopts::value<std::vector<std::string>>());
+
+        options.parse_positional({"input"});
+        options.positional_help("OLD_LOGO.BIN NEW_LOGO.BIN");
+
+        auto args = options.parse(argc, argv);
+
+        if(args.count("help"))
+        {
+            std::cerr<<options.help()<<'\n';
+            return {};
+        }
+
+        if(!args.count("input") || std::size(args["input"].as<std::vector<std::string>>()) != 2)
+            throw cxxopts::OptionException{"Exactly two input files are needed"};
+
+        Args output_args;
+        output_args.old_filename = args["input"].as<std::vector<std::string>>()[0];
+        output_args.new_filename = args["input"].as<std::vector<std::string>>()[1];
+        output_args.num_threads = args["jobs"].as<unsigned int>();
+        output_args.all = args.count("all");
+        output_args.hashes = args.count("hashes");
+
+        return output_args;
+    }
+    catch(const cxxopts::OptionException & e)
+    {
+        std::cerr<<options.help()<<'\n'<<e.what()<<'\n';
+        return {};
+    }
+}
+
+std::string size_str(const Image_header & header)
+{
+    return std::to_string(header.width) + "x" + std::to_string(header.height);
+}
+
+int main(int argc, char * argv[])
+{
+    auto args = get_args(argc, argv);
+    if(!args)
+        return exit_trouble;
+
+    try
+    {
+        auto old_file = Mapped_file{args->old_filename};
+        auto new_file = Mapped_file{args->new_filename};
+
+        auto diffs = diff_logos(old_file.data(), args->old_filename, new_file.data(), args->new_filename, args->num_threads);
+
+        auto num_different = 0u;
+        for(auto && diff: diffs)
+        {
+            if(diff.status != Diff_status::same)
+                ++num_different;
+            else if(!args->all)
+                continue;
+
+            switch(diff.status)
+            {
+            case Diff_status::same:
+                std::cout<<"Same: "<<diff.name;
+                break;
+            case Diff_status::reencoded:
+                std::cout<<"Re-encoded: "<<diff.name<<" (same pixels)";
+                break;
+            case Diff_status::changed:
+                std::cout<<"Changed: "<<diff.name<<" ("<<size_str(diff.new_header)<<"): "<<diff.changed_pixels<<" pixels in "
+                    <<diff.right - diff.left<<"x"<<diff.bottom - diff.top<<" at "<<diff.left<<","<<diff.top;
+                break;
+            case Diff_status::resized:
+                std::cout<<"Resized: "<<diff.name<<" "<<size_str(diff.old_header)<<" -> "<<size_str(diff.new_header);
+                break;
+            case Diff_status::added:
+                std::cout<<"Added: "<<diff.name<<" ("<<size_str(diff.new_header)<<")";
+                break;
+            case Diff_status::removed:
+                std::cout<<"Removed: "<<diff.name<<" ("<<size_str(diff.old_header)<<")";
+                break;
+            }
+
+            if(args->hashes)
+            {
+                std::cout<<" "<<(diff.status == Diff_status::added ? std::string(16, '-') : hash_to_string(diff.old_hash))
+                    <<" "<<(diff.status == Diff_status::removed ? std::string(16, '-') : hash_to_string(diff.new_hash));
+            }
+            std::cout<<'\n';
+        }
+
+        return num_different == 0 ? exit_same : exit_different;
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        return exit_trouble;
+    }
+}
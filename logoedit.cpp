@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include "logo.hpp"
+#include "mapped_file.hpp"
+
+struct Recolor
+{
+    Rgb from;
+    Rgb to;
+};
+
+struct Args
+{
+    std::string input_filename;
+    std::string output_filename;
+    std::vector<std::string> only;
+    std::vector<Recolor> recolors;
+    std::optional<std::pair<std::size_t, std::size_t>> crop_rows; // first row, number of rows
+    bool histogram {false};
+    std::size_t histogram_top {10};
+};
+
+// RRGGBB, optionally starting with #
+Rgb parse_color(std::string str)
+{
+    if(!std::empty(str) && str.front() == '#')
+        str.erase(0, 1);
+
+    if(std::size(str) != 6 || str.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+        throw cxxopts::OptionException{"Invalid color: " + str};
+
+    auto value = std::stoul(str, nullptr, 16);
+    return Rgb{static_cast<std::uint8_t>(value >> 16), static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value)};
+}
+
+std::string color_str(const Rgb & color)
+{
+    std::ostringstream out;
+    out<<'#'<<std::hex<<std::setfill('0')<<std::setw(2)<<+color.r<<std::setw(2)<<+color.g<<std::setw(2)<<+color.b;
+    return out.str();
+}
+
+std::optional<Args> get_args(int argc, char * argv[])
+{
+    cxxopts::Options options{argv[0], "Edit images in a Moto logo.bin file without decoding them"};
+
+    try
+    {
+        options.add_options()
+            ("h,help",      "Show this message and quit")
+            ("o,output",    "Output filename. Edits the input in place by default", cxxopts::value<std::string>(), "OUTPUT")
+            ("only",        "Only edit these entries. Comma separated list of names, which may use * and ? wildcards", cxxopts::value<std::vector<std::string>>(), "NAME[,NAME...]")
+            ("recolor",     "Replace every pixel of one color with another. May be given more than once, and is applied in order", cxxopts::value<std::vector<std::string>>(), "RRGGBB:RRGGBB")
+            ("crop-rows",   "Keep COUNT rows starting from row FIRST, after recoloring", cxxopts::value<std::string>(), "FIRST:COUNT")
+            ("histogram",   "Print the most common colors in each image")
+            ("top",         "Number of colors --histogram prints", cxxopts::value<std::size_t>()->default_value("10"), "N")
+            ("input",       "Input filename", cxxopts::value<std::string>());
+
+        options.parse_positional({"input"});
+        options.positional_help("LOGO.BIN");
+
+        auto args = options.parse(argc, argv);
+
+        if(args.count("help"))
+        {
+            std::cerr<<options.help()<<'\n';
+            return {};
+        }
+
+        if(!args.count("input"))
+            throw cxxopts::OptionException{"No input file given"};
+
+        Args output_args;
+        output_args.input_filename = args["input"].as<std::string>();
+        output_args.output_filename = args.count("output") ? args["output"].as<std::string>() : output_args.input_filename;
+
+        if(args.count("only"))
+            output_args.only = args["only"].as<std::vector<std::string>>();
+
+        if(args.count("recolor"))
+        {
+            for(auto && recolor: args["recolor"].as<std::vector<std::string>>())
+            {
+                auto colon = recolor.find(':');
+                if(colon == std::string::npos)
+                    throw cxxopts::OptionException{"Invalid recolor: " + recolor};
+
+                output_args.recolors.push_back({parse_color(recolor.substr(0, colon)), parse_color(recolor.substr(colon + 1))});
+            }
+        }
+
+        if(args.count("crop-rows"))
+        {
+            auto crop = args["crop-rows"].as<std::string>();
+            if(auto colon = crop.find(':'); colon != std::string::npos)
+            {
+                try
+                {
+                    output_args.crop_rows = std::pair{std::stoul(crop.substr(0, colon)), std::stoul(crop.substr(colon + 1))};
+                }
+                catch(const std::logic_error &)
+                {
+                    throw cxxopts::OptionException{"Invalid crop: " + crop};
+                }
+            }
+            else
+                throw cxxopts::OptionException{"Invalid crop: " + crop};
+        }
+
+        output_args.histogram = args.count("histogram");
+        output_args.histogram_top = args["top"].as<std::size_t>();
+
+        if(std::empty(output_args.recolors) && !output_args.crop_rows && !output_args.histogram)
+            throw cxxopts::OptionException{"Nothing to do. Give --recolor, --crop-rows, or --histogram"};
+
+        return output_args;
+    }
+    catch(const cxxopts::OptionException & e)
+    {
+        std::cerr<<options.help()<<'\n'<<e.what()<<'\n';
+        return {};
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    auto args = get_args(argc, argv);
+    if(!args)
+        return EXIT_FAILURE;
+
+    try
+    {
+        auto file = Mapped_file{args->input_filename};
+        auto data = file.data();
+
+        auto entries = parse_directory(data, args->input_filename);
+        auto selected_entries = std::empty(args->only) ? entries : select_entries(entries, args->only, args->input_filename);
+        auto selected = [&selected_entries](const Logo_entry & entry)
+        {
+            return std::any_of(std::begin(selected_entries), std::end(selected_entries), [&entry](const auto & e) { return e.offset == entry.offset && e.name == entry.name; });
+        };
+
+        if(args->histogram)
+        {
+            for(auto && entry: selected_entries)
+            {
+                auto image_data = entry_data(data, entry);
+                auto header = read_image_header(image_data, entry.name, args->input_filename);
+                auto histogram = color_histogram(image_data, entry.name, args->input_filename);
+
+                std::cout<<entry.name<<" ("<<header.width<<"x"<<header.height<<"): "<<std::size(histogram)<<" colors\n";
+                for(std::size_t i = 0; i < std::size(histogram) && i < args->histogram_top; ++i)
+                {
+                    auto && [color, count] = histogram[i];
+                    std::cout<<"  "<<color_str(color)<<std::setw(12)<<count
+                        <<std::fixed<<std::setprecision(2)<<std::setw(8)<<100.0 * count / (header.width * header.height)<<"%\n";
+                }
+            }
+        }
+
+        if(std::empty(args->recolors) && !args->crop_rows)
+            return EXIT_SUCCESS;
+
+        // written to a temp file first, so editing in place is safe
+        Logo_writer writer{args->output_filename, std::size(entries)};
+        for(auto && entry: entries)
+        {
+            auto image_data = entry_data(data, entry);
+            if(!selected(entry))
+            {
+                writer.add(entry.name, image_data);
+                continue;
+            }
+
+            auto edited = std::vector<std::byte>(std::begin(image_data), std::end(image_data));
+            for(auto && recolor: args->recolors)
+                edited = recolor_image(edited, recolor.from, recolor.to, entry.name, args->input_filename);
+            if(args->crop_rows)
+                edited = crop_image_rows(edited, args->crop_rows->first, args->crop_rows->second, entry.name, args->input_filename);
+
+            writer.add(entry.name, edited);
+
+            auto header = read_image_header(edited, entry.name, args->output_filename);
+            std::cout<<"Edited "<<entry.name<<" ("<<header.width<<"x"<<header.height<<", "<<std::size(image_data)<<" -> "<<std::size(edited)<<" bytes)\n";
+        }
+        writer.finish();
+    }
+    catch(const std::runtime_error & e)
+    {
+        std::cerr<<e.what()<<'\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+
+#if __has_include(<sys/mman.h>) && __has_include(<sys/stat.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#define HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "readb.hpp"
+
+Mapped_file::Mapped_file(const std::string & filename)
+{
+#ifdef HAS_MMAP
+    auto fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error{"Could not open input file: " + filename + ". " + std::strerror(errno)};
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        map_size_ = static_cast<std::size_t>(st.st_size);
+
+        // mmap can't map an empty file, but there's nothing to read anyway
+        if(map_size_ == 0)
+        {
+            close(fd);
+            return;
+        }
+
+        if(auto map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0); map != MAP_FAILED)
+        {
+            close(fd);
+            map_ = map;
+            data_ = std::span{static_cast<const std::byte *>(map_), map_size_};
+            return;
+        }
+    }
+
+    // not a regular file, or mmap failed. Fall back to reading it in
+    close(fd);
+    map_size_ = 0;
+#endif
+
+    buffer_ = read_file(filename);
+    data_ = std::span{std::data(buffer_), std::size(buffer_)};
+}
+
+Mapped_file::~Mapped_file()
+{
+#ifdef HAS_MMAP
+    if(map_)
+        munmap(map_, map_size_);
+#endif
+}
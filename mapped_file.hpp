@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+// read-only view of a whole file. Uses mmap where available, otherwise falls back to reading the file into memory
+class Mapped_file
+{
+public:
+    explicit Mapped_file(const std::string & filename);
+    ~Mapped_file();
+
+    Mapped_file(const Mapped_file &) = delete;
+    Mapped_file & operator=(const Mapped_file &) = delete;
+
+    std::span<const std::byte> data() const { return data_; }
+
+private:
+    std::span<const std::byte> data_;
+    std::vector<std::byte> buffer_;
+    void * map_ {nullptr};
+    std::size_t map_size_ {0};
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,189 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <cstddef>
+
+// 0 means use every available core
+inline unsigned int resolve_num_threads(unsigned int num_threads)
+{
+    if(num_threads == 0)
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    return num_threads;
+}
+
+// call func(i) for every i in [0, count) spread across num_threads threads.
+// Once anything throws, no new indices are started, and the exception from the lowest index is rethrown
+template <typename Func>
+void parallel_for(std::size_t count, unsigned int num_threads, Func && func)
+{
+    num_threads = std::min<std::size_t>(resolve_num_threads(num_threads), count);
+
+    if(num_threads <= 1)
+    {
+        for(std::size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next {0};
+    std::atomic<bool> failed {false};
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    std::size_t error_index {count};
+
+    auto worker = [&]()
+    {
+        for(auto i = next++; i < count && !failed; i = next++)
+        {
+            try
+            {
+                func(i);
+            }
+            catch(...)
+            {
+                std::scoped_lock lock{error_mutex};
+                if(i < error_index)
+                {
+                    error = std::current_exception();
+                    error_index = i;
+                }
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(auto t = 1u; t < num_threads; ++t)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for(auto && t: threads)
+        t.join();
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+// call produce(i) for every i in [0, count) on num_threads worker threads, and pass each result to consume(i, result)
+// on the calling thread, in order. Workers only run a limited distance ahead of consume, so no more than a few results
+// are held at once. If anything throws, everything before it is still consumed, and then the exception is rethrown
+template <typename Produce, typename Consume>
+void parallel_ordered(std::size_t count, unsigned int num_threads, Produce && produce, Consume && consume)
+{
+    using Result = std::invoke_result_t<Produce &, std::size_t>;
+
+    num_threads = std::min<std::size_t>(resolve_num_threads(num_threads), count);
+
+    if(num_threads <= 1)
+    {
+        for(std::size_t i = 0; i < count; ++i)
+            consume(i, produce(i));
+        return;
+    }
+
+    const auto window = std::size_t{num_threads} * 2;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::optional<Result>> results(count);
+    std::size_t next {0};
+    std::size_t consumed {0};
+    bool stop {false};
+
+    std::exception_ptr error;
+    std::size_t error_index {count};
+
+    auto worker = [&]()
+    {
+        while(true)
+        {
+            std::size_t i;
+            {
+                std::unique_lock lock{mutex};
+                // nothing after a failure is needed, but everything before it still is
+                cv.wait(lock, [&]{ return stop || next >= error_index || next < consumed + window; });
+                if(stop || next >= error_index)
+                    return;
+                i = next++;
+            }
+
+            try
+            {
+                auto result = produce(i);
+
+                std::scoped_lock lock{mutex};
+                results[i].emplace(std::move(result));
+            }
+            catch(...)
+            {
+                std::scoped_lock lock{mutex};
+                if(i < error_index)
+                {
+                    error = std::current_exception();
+                    error_index = i;
+                }
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(auto t = 0u; t < num_threads; ++t)
+        threads.emplace_back(worker);
+
+    auto finish = [&]()
+    {
+        {
+            std::scoped_lock lock{mutex};
+            stop = true;
+        }
+        cv.notify_all();
+
+        for(auto && t: threads)
+            t.join();
+    };
+
+    try
+    {
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            std::optional<Result> result;
+            {
+                std::unique_lock lock{mutex};
+                cv.wait(lock, [&]{ return results[i] || error_index <= i; });
+                if(!results[i])
+                    break;
+
+                result.swap(results[i]);
+                consumed = i + 1;
+            }
+            cv.notify_all();
+
+            consume(i, std::move(*result));
+        }
+    }
+    catch(...)
+    {
+        finish();
+        throw;
+    }
+
+    finish();
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+#endif // PARALLEL_HPP
@@ -2,6 +2,8 @@
 
 #include <stdexcept>
 
+#include <cerrno>
+#include <csetjmp>
 #include <cstring>
 
 class Png
@@ -31,7 +33,7 @@ private:
     png_image png_;
 };
 
-Image read_png(const std::string & input_filename)
+Image read_png(const std::string & input_filename, std::size_t row_alignment)
 {
     Png png_img;
 
@@ -40,22 +42,132 @@ Image read_png(const std::string & input_filename)
 
     png_img->format = PNG_FORMAT_RGB;
 
-    Image img{png_img->width, png_img->height};
-    if(std::size(img.image_data) != PNG_IMAGE_SIZE(png_img.get()))
+    // checked before anything is allocated for the pixels
+    if(png_img->width > max_image_dimension || png_img->height > max_image_dimension)
+        throw std::runtime_error {"Error reading " + input_filename + ": image dimensions are too large (" + std::to_string(png_img->width) + "x" + std::to_string(png_img->height)
+            + "). The limit is " + std::to_string(max_image_dimension) + "x" + std::to_string(max_image_dimension)};
+
+    Image img{png_img->width, png_img->height, row_alignment};
+    if(img.width * 3 != PNG_IMAGE_ROW_STRIDE(png_img.get()))
         throw std::runtime_error {"PNG size mismatched"};
 
-    if(!png_image_finish_read(png_img, nullptr, std::data(img.image_data), PNG_IMAGE_ROW_STRIDE(png_img.get()), nullptr))
+    // libpng writes straight into the image, skipping over any row padding
+    if(!png_image_finish_read(png_img, nullptr, std::data(img.image_data), static_cast<png_int_32>(img.stride), nullptr))
         throw std::runtime_error {"Could not finish reading PNG: " + std::string{png_img->message}};
 
     return img;
 }
 
-void write_png(const Image & img)
+void write_png(const Image & img, const Png_options & options)
 {
-    Png png_img;
-    png_img->width = img.width;
-    png_img->height = img.height;
+    Png_writer png{img.name, img.width, img.height, options};
+    write_rows(img, png);
+}
+
+void parse_png_level(const std::string & level, Png_options & options)
+{
+    if(level == "default")
+        options.level = -1;
+    else if(level == "fast")
+    {
+        options.level = 1;
+        if(options.filter == -1)
+            options.filter = PNG_FILTER_NONE;
+    }
+    else if(std::size(level) == 1 && level[0] >= '0' && level[0] <= '9')
+        options.level = level[0] - '0';
+    else
+        throw std::runtime_error {"Invalid PNG compression level: " + level};
+}
+
+void parse_png_filter(const std::string & filter, Png_options & options)
+{
+    if(filter == "default")
+        options.filter = -1;
+    else if(filter == "none")
+        options.filter = PNG_FILTER_NONE;
+    else if(filter == "sub")
+        options.filter = PNG_FILTER_SUB;
+    else if(filter == "up")
+        options.filter = PNG_FILTER_UP;
+    else if(filter == "avg")
+        options.filter = PNG_FILTER_AVG;
+    else if(filter == "paeth")
+        options.filter = PNG_FILTER_PAETH;
+    else if(filter == "all")
+        options.filter = PNG_ALL_FILTERS;
+    else
+        throw std::runtime_error {"Invalid PNG filter: " + filter};
+}
+
+Png_writer::Png_writer(const std::string & filename, std::size_t width, std::size_t height, const Png_options & options): filename_{filename}
+{
+    file_ = std::fopen(filename.c_str(), "wb");
+    if(!file_)
+        throw std::runtime_error {"Error writing PNG: could not open " + filename + ". " + std::strerror(errno)};
+
+    png_ = png_create_write_struct(PNG_LIBPNG_VER_STRING, this, error_fn, nullptr);
+    if(png_)
+        info_ = png_create_info_struct(png_);
+    if(!png_ || !info_)
+    {
+        png_destroy_write_struct(&png_, nullptr);
+        std::fclose(file_);
+        throw std::runtime_error {"Error writing PNG: out of memory"};
+    }
+
+    // libpng reports errors by longjmp-ing back here. Nothing in this scope needs destructing
+    if(setjmp(png_jmpbuf(png_)))
+    {
+        png_destroy_write_struct(&png_, &info_);
+        std::fclose(file_);
+        throw std::runtime_error {"Error writing PNG: " + error_};
+    }
 
-    if(!png_image_write_to_file(png_img, img.name.c_str(), false, std::data(img.image_data), PNG_IMAGE_ROW_STRIDE(png_img.get()), nullptr))
-        throw std::runtime_error {"Error writing PNG: " + std::string{png_img->message}};
+    png_init_io(png_, file_);
+
+    if(options.level >= 0)
+        png_set_compression_level(png_, options.level);
+    if(options.filter >= 0)
+        png_set_filter(png_, PNG_FILTER_TYPE_BASE, options.filter);
+
+    png_set_IHDR(png_, info_, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_, info_);
+}
+
+Png_writer::~Png_writer()
+{
+    if(png_)
+    {
+        png_destroy_write_struct(&png_, &info_);
+        std::fclose(file_);
+    }
+}
+
+void Png_writer::write_row(const std::uint8_t * row)
+{
+    if(setjmp(png_jmpbuf(png_)))
+        throw std::runtime_error {"Error writing PNG: " + error_};
+
+    png_write_row(png_, row);
+}
+
+void Png_writer::finish()
+{
+    if(setjmp(png_jmpbuf(png_)))
+        throw std::runtime_error {"Error writing PNG: " + error_};
+
+    png_write_end(png_, nullptr);
+    png_destroy_write_struct(&png_, &info_);
+
+    auto close_failed = std::fclose(file_) != 0;
+    file_ = nullptr;
+    if(close_failed)
+        throw std::runtime_error {"Error writing PNG: could not write " + filename_ + ". " + std::strerror(errno)};
+}
+
+void Png_writer::error_fn(png_structp png, png_const_charp message)
+{
+    static_cast<Png_writer *>(png_get_error_ptr(png))->error_ = message;
+    png_longjmp(png, 1);
 }
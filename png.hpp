@@ -3,11 +3,49 @@
 
 #include <string>
 
+#include <cstdint>
+#include <cstdio>
+
 #include <png.h>
 
 #include "image.hpp"
 
-Image read_png(const std::string & input_filename);
-void write_png(const Image & img);
+struct Png_options
+{
+    int level {-1};  // zlib compression level, 0 - 9. -1 uses libpng's default
+    int filter {-1}; // PNG_FILTER_* flags. -1 lets libpng pick
+};
+
+// parse a compression level: 0 - 9, "default", or "fast" (level 1, and no filtering unless a filter is set too)
+void parse_png_level(const std::string & level, Png_options & options);
+// parse a row filter: none, sub, up, avg, paeth, all, or default
+void parse_png_filter(const std::string & filter, Png_options & options);
+
+// see Image::set_size for row_alignment
+Image read_png(const std::string & input_filename, std::size_t row_alignment = 0);
+void write_png(const Image & img, const Png_options & options = {});
+
+// write a PNG one row at a time
+class Png_writer: public Row_writer
+{
+public:
+    Png_writer(const std::string & filename, std::size_t width, std::size_t height, const Png_options & options = {});
+    ~Png_writer() override;
+
+    Png_writer(const Png_writer &) = delete;
+    Png_writer & operator=(const Png_writer &) = delete;
+
+    void write_row(const std::uint8_t * row) override;
+    void finish() override;
+
+private:
+    static void error_fn(png_structp png, png_const_charp message);
+
+    std::string filename_;
+    std::FILE * file_ {nullptr};
+    png_structp png_ {nullptr};
+    png_infop info_ {nullptr};
+    std::string error_;
+};
 
 #endif // PNG_HPP
@@ -1,21 +1,27 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 
 #include <cxxopts.hpp>
 
+#include "formats.hpp"
 #include "png.hpp"
 #include "logo.hpp"
+#include "stats.hpp"
 
 struct Args
 {
     std::vector<std::string> input_filenames;
     std::string output_filename;
+    Pack_options pack_options;
+    bool stats {false};
+    std::string stats_json;
 };
 
 std::optional<Args> get_args(int argc, char * argv[])
 {
-    cxxopts::Options options{argv[0], "Pack PNG files into a Moto logo.bin file"};
+    cxxopts::Options options{argv[0], "Pack PNG files, or other image formats, into a Moto logo.bin file"};
 
     // TODO: inputs may need to be ordered and have specific names. Some are probably required too
     try
@@ -23,10 +29,19 @@ std::optional<Args> get_args(int argc, char * argv[])
         options.add_options()
             ("h,help",   "Show this message and quit")
             ("o,output", "output filename. Default filename is logo.bin", cxxopts::value<std::string>()->default_value("logo.bin"), "OUTPUT")
+            ("j,jobs",   "Number of images to compress in parallel. 0 uses all available cores", cxxopts::value<unsigned int>()->default_value("1"), "N")
+            ("optimize", "Compress images as small as possible. Slower than the default encoder")
+            ("cache",    "Cache compressed images in DIR, and reuse them when an input's pixels haven't changed", cxxopts::value<std::string>(), "DIR")
+            ("update",   "Start from an existing logo.bin file, replacing only the images given as inputs. Other images are copied without being re-encoded", cxxopts::value<std::string>(), "LOGO.BIN")
+            ("no-dedup", "Store every image separately, even when identical to another one")
+            ("format",   "Input image format: png, ppm, bmp, or raw (packed RGB, with no header). Guessed from each file's extension by default", cxxopts::value<std::string>(), "FORMAT")
+            ("raw-size", "Dimensions of raw input images", cxxopts::value<std::string>(), "WIDTHxHEIGHT")
+            ("stats",    "Print sizes, RLE packet counts and time spent in each phase, for every image")
+            ("stats-json", "Write the same statistics as --stats to FILE as JSON. - writes to stdout", cxxopts::value<std::string>(), "FILE")
             ("input",    "Input filenames", cxxopts::value<std::vector<std::string>>());
 
         options.parse_positional({"input"});
-        options.positional_help("INPUT_PNG_FILES ...");
+        options.positional_help("INPUT_IMAGE_FILES ...");
 
         auto args = options.parse(argc, argv);
 
@@ -39,6 +54,42 @@ std::optional<Args> get_args(int argc, char * argv[])
         Args output_args;
         output_args.input_filenames = args["input"].as<std::vector<std::string>>();
         output_args.output_filename = args["output"].as<std::string>();
+        output_args.pack_options.num_threads = args["jobs"].as<unsigned int>();
+        if(args.count("optimize"))
+            output_args.pack_options.rle_mode = Rle_mode::optimal;
+        if(args.count("cache"))
+            output_args.pack_options.cache_dir = args["cache"].as<std::string>();
+        if(args.count("update"))
+            output_args.pack_options.update_filename = args["update"].as<std::string>();
+        output_args.pack_options.dedup = !args.count("no-dedup");
+
+        output_args.stats = args.count("stats");
+        if(args.count("stats-json"))
+            output_args.stats_json = args["stats-json"].as<std::string>();
+
+        if(args.count("format"))
+        {
+            try
+            {
+                output_args.pack_options.input_format = parse_image_format(args["format"].as<std::string>());
+            }
+            catch(const std::runtime_error & e)
+            {
+                throw cxxopts::OptionException{e.what()};
+            }
+        }
+
+        if(args.count("raw-size"))
+        {
+            try
+            {
+                std::tie(output_args.pack_options.raw_width, output_args.pack_options.raw_height) = parse_image_size(args["raw-size"].as<std::string>());
+            }
+            catch(const std::runtime_error & e)
+            {
+                throw cxxopts::OptionException{e.what()};
+            }
+        }
 
         return output_args;
     }
@@ -55,9 +106,22 @@ int main(int argc, char * argv[])
     if(!args)
         return EXIT_FAILURE;
 
+    Logo_stats stats;
+    if(args->stats || !std::empty(args->stats_json))
+        args->pack_options.stats = &stats;
+
+    // keep stdout clean when JSON is written there, so it can be parsed
+    auto & messages = args->stats_json == "-" ? std::cerr : std::cout;
+    args->pack_options.progress = &messages;
+
     try
     {
-        write_logo(args->input_filenames, args->output_filename);
+        write_logo(args->input_filenames, args->output_filename, args->pack_options);
+
+        if(args->stats)
+            print_stats(messages, {stats});
+        if(!std::empty(args->stats_json))
+            write_stats_json(args->stats_json, {stats});
     }
     catch(const std::runtime_error & e)
     {
@@ -1,6 +1,7 @@
 #ifndef READB_HPP
 #define READB_HPP
 
+#include <algorithm>
 #include <array>
 #include <bit>
 #include <fstream>
@@ -8,6 +9,7 @@
 #include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -24,8 +26,8 @@ requires(T begin, T end)
 {
     begin == end;
     ++begin;
-    *begin = std::declval<decltype(*begin)>();
-    *begin++ = std::declval<decltype(*begin)>();
+    *begin;
+    *begin++;
     requires std::is_same_v<decltype(begin == end), bool>;
     requires std::is_same_v<decltype(++begin), T&>;
 } &&
@@ -54,6 +56,25 @@ inline std::vector<std::byte> read_file(const std::string & filename)
         throw std::runtime_error{"Could not open input region file: " + filename + ". " + std::strerror(errno)};
 
     std::vector<std::byte> data;
+
+    // size the buffer up front and read it all in one go if we can
+    if(file.seekg(0, std::ios::end))
+    {
+        if(auto size = file.tellg(); size >= 0 && file.seekg(0, std::ios::beg))
+        {
+            data.resize(static_cast<std::size_t>(size));
+            file.read(reinterpret_cast<char *>(std::data(data)), std::size(data));
+            data.resize(static_cast<std::size_t>(file.gcount()));
+
+            if(file.bad())
+                throw std::runtime_error{"Could not open read region file: " + filename + ". " + std::strerror(errno)};
+
+            return data;
+        }
+    }
+
+    // not seekable (pipe, etc). Read it in chunks
+    file.clear();
     std::array<std::byte, 4096> buffer;
 
     do
@@ -134,7 +155,7 @@ T readb(InputIter & begin, InputIter end, std::endian endian = std::endian::litt
 template<typename E, Byte_input_iter InputIter> requires std::is_enum_v<E>
 E readb(InputIter & begin, InputIter end, std::endian endian = std::endian::little)
 {
-    return static_cast<E>(readb_i<std::underlying_type_t<E>>(begin, end, endian));
+    return static_cast<E>(readb<std::underlying_type_t<E>>(begin, end, endian));
 }
 
 template <Byte_input_iter InputIter>
@@ -175,4 +196,131 @@ void writestr(const std::string_view & str, std::size_t len, OutputIter & out)
         *out++ = static_cast<std::byte>('\0');
 }
 
+// cursors over contiguous memory. Bounds are checked once per field, and multi-byte fields are copied with memcpy,
+// rather than a byte at a time like the iterator versions above
+
+// reads fields from a span of bytes, in order
+class Byte_reader
+{
+public:
+    explicit Byte_reader(std::span<const std::byte> data): data_{data} {}
+
+    template <typename T> requires(std::is_arithmetic_v<T>)
+    T read(std::endian endian = std::endian::little)
+    {
+        T t;
+        std::memcpy(&t, take(sizeof(T)), sizeof(T));
+        if(std::endian::native != endian)
+            t = bswap(t);
+        return t;
+    }
+
+    template <typename E> requires(std::is_enum_v<E>)
+    E read(std::endian endian = std::endian::little)
+    {
+        return static_cast<E>(read<std::underlying_type_t<E>>(endian));
+    }
+
+    std::string read_str(std::size_t len)
+    {
+        auto start = take(len);
+        return std::string(reinterpret_cast<const char *>(start), len);
+    }
+
+    std::span<const std::byte> read_bytes(std::size_t len)
+    {
+        auto start = take(len);
+        return {start, len};
+    }
+
+    void skip(std::size_t len) { take(len); }
+
+    void seek(std::size_t pos)
+    {
+        if(pos > std::size(data_))
+            throw std::runtime_error{"Unexpected end of input"};
+        pos_ = pos;
+    }
+
+    std::size_t position() const { return pos_; }
+    std::size_t remaining() const { return std::size(data_) - pos_; }
+
+private:
+    const std::byte * take(std::size_t len)
+    {
+        if(len > remaining())
+            throw std::runtime_error{"Unexpected end of input"};
+
+        auto start = std::data(data_) + pos_;
+        pos_ += len;
+        return start;
+    }
+
+    std::span<const std::byte> data_;
+    std::size_t pos_ {0};
+};
+
+// writes fields into a span of bytes, in order. The span must already be large enough
+class Byte_writer
+{
+public:
+    explicit Byte_writer(std::span<std::byte> data): data_{data} {}
+
+    template <typename T> requires(std::is_arithmetic_v<T>)
+    void write(T t, std::endian endian = std::endian::little)
+    {
+        if(std::endian::native != endian)
+            t = bswap(t);
+        std::memcpy(take(sizeof(T)), &t, sizeof(T));
+    }
+
+    template <typename E> requires(std::is_enum_v<E>)
+    void write(E e, std::endian endian = std::endian::little)
+    {
+        write(static_cast<std::underlying_type_t<E>>(e), endian);
+    }
+
+    // write exactly len bytes, truncating str or padding it with '\0'
+    void write_str(std::string_view str, std::size_t len)
+    {
+        auto start = take(len);
+        auto copy_len = std::min(len, std::size(str));
+        std::memcpy(start, std::data(str), copy_len);
+        std::memset(start + copy_len, 0, len - copy_len);
+    }
+
+    void write_bytes(const void * data, std::size_t len)
+    {
+        std::memcpy(take(len), data, len);
+    }
+
+    void fill(std::byte value, std::size_t len)
+    {
+        std::memset(take(len), std::to_integer<int>(value), len);
+    }
+
+    // the next len bytes, for the caller to fill in directly
+    std::span<std::byte> next(std::size_t len)
+    {
+        return {take(len), len};
+    }
+
+    std::size_t position() const { return pos_; }
+    std::size_t remaining() const { return std::size(data_) - pos_; }
+
+private:
+    std::byte * take(std::size_t len)
+    {
+        if(len > remaining())
+            throw std::logic_error{"Output buffer too small"};
+
+        auto start = std::data(data_) + pos_;
+        pos_ += len;
+        return start;
+    }
+
+    std::span<std::byte> data_;
+    std::size_t pos_ {0};
+};
+
 #endif // READB_HPP
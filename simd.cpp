@@ -0,0 +1,153 @@
+#include "simd.hpp"
+
+#include <algorithm>
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) // also clang
+#define HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// A run of identical pixels is a span where every byte matches the byte one pixel (3 bytes) before it,
+// so we can find the end of a run by comparing the data against itself offset by 3, as many bytes at a time as we can.
+// The first mismatching byte is in the first pixel that isn't part of the run
+
+namespace
+{
+    std::size_t rgb_run_length_tail(const std::uint8_t * pixels, std::size_t num_bytes, std::size_t i)
+    {
+        for(; i < num_bytes; ++i)
+        {
+            if(pixels[i] != pixels[i - 3])
+                return i / 3;
+        }
+        return num_bytes / 3;
+    }
+
+    std::size_t rgb_run_length_scalar(const std::uint8_t * pixels, std::size_t num_pixels)
+    {
+        return rgb_run_length_tail(pixels, num_pixels * 3, 3);
+    }
+
+#ifdef HAS_X86_SIMD
+    __attribute__((target("sse2")))
+    std::size_t rgb_run_length_sse2(const std::uint8_t * pixels, std::size_t num_pixels)
+    {
+        const auto num_bytes = num_pixels * 3;
+        auto i = std::size_t{3};
+        for(; i + 16 <= num_bytes; i += 16)
+        {
+            auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+            auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i - 3));
+            auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+            if(mask != 0xFFFFu)
+                return (i + __builtin_ctz(~mask)) / 3;
+        }
+        return rgb_run_length_tail(pixels, num_bytes, i);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t rgb_run_length_avx2(const std::uint8_t * pixels, std::size_t num_pixels)
+    {
+        const auto num_bytes = num_pixels * 3;
+        auto i = std::size_t{3};
+        for(; i + 32 <= num_bytes; i += 32)
+        {
+            auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i));
+            auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i - 3));
+            auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+            if(mask != 0xFFFFFFFFu)
+                return (i + __builtin_ctz(~mask)) / 3;
+        }
+        return rgb_run_length_tail(pixels, num_bytes, i);
+    }
+#endif
+
+    using Run_length_fun = std::size_t (*)(const std::uint8_t *, std::size_t);
+
+    Run_length_fun select_rgb_run_length()
+    {
+#ifdef HAS_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return rgb_run_length_avx2;
+        if(__builtin_cpu_supports("sse2"))
+            return rgb_run_length_sse2;
+#endif
+        return rgb_run_length_scalar;
+    }
+}
+
+namespace
+{
+    void bgr_to_rgb_scalar(const std::uint8_t * src, std::uint8_t * dst, std::size_t num_pixels)
+    {
+        for(std::size_t i = 0; i < num_pixels; ++i, src += 3, dst += 3)
+        {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+    }
+
+#ifdef HAS_X86_SIMD
+    // 16 bytes holds 5 whole pixels. Swap those, and leave the 16th byte for the next iteration to overwrite.
+    // Stop while a full 16 byte load and store still fit
+    __attribute__((target("ssse3")))
+    void bgr_to_rgb_ssse3(const std::uint8_t * src, std::uint8_t * dst, std::size_t num_pixels)
+    {
+        const auto shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+        for(; num_pixels >= 6; num_pixels -= 5, src += 15, dst += 15)
+        {
+            auto px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(px, shuffle));
+        }
+        bgr_to_rgb_scalar(src, dst, num_pixels);
+    }
+#endif
+
+    using Bgr_to_rgb_fun = void (*)(const std::uint8_t *, std::uint8_t *, std::size_t);
+
+    Bgr_to_rgb_fun select_bgr_to_rgb()
+    {
+#ifdef HAS_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("ssse3"))
+            return bgr_to_rgb_ssse3;
+#endif
+        return bgr_to_rgb_scalar;
+    }
+}
+
+std::size_t rgb_run_length(const std::uint8_t * pixels, std::size_t num_pixels)
+{
+    static const auto impl = select_rgb_run_length();
+
+    if(num_pixels == 0)
+        return 0;
+
+    return impl(pixels, num_pixels);
+}
+
+void bgr_to_rgb(const std::uint8_t * src, std::uint8_t * dst, std::size_t num_pixels)
+{
+    static const auto impl = select_bgr_to_rgb();
+    impl(src, dst, num_pixels);
+}
+
+void fill_rgb(std::uint8_t * dst, std::uint8_t r, std::uint8_t g, std::uint8_t b, std::size_t count)
+{
+    if(count == 0)
+        return;
+
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+
+    // keep doubling the filled section until it's done
+    const auto size = count * 3;
+    for(std::size_t filled = 3; filled < size; filled *= 2)
+        std::memcpy(dst + filled, dst, std::min(filled, size - filled));
+}
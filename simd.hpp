@@ -0,0 +1,17 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// count how many packed RGB pixels at the start of pixels are the same color as the first one,
+// checking no more than num_pixels. Uses AVX2 or SSE2 when the CPU supports them
+std::size_t rgb_run_length(const std::uint8_t * pixels, std::size_t num_pixels);
+
+// convert num_pixels packed BGR pixels to RGB. Uses SSSE3 when the CPU supports it. src and dst must not overlap
+void bgr_to_rgb(const std::uint8_t * src, std::uint8_t * dst, std::size_t num_pixels);
+
+// write count copies of an RGB pixel to dst
+void fill_rgb(std::uint8_t * dst, std::uint8_t r, std::uint8_t g, std::uint8_t b, std::size_t count);
+
+#endif // SIMD_HPP
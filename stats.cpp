@@ -0,0 +1,236 @@
+#include "stats.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+
+namespace
+{
+    // length of the valid UTF-8 sequence starting at str[i], or 0 if there isn't one
+    std::size_t utf8_length(const std::string & str, std::size_t i)
+    {
+        auto byte = [&str](std::size_t j) { return static_cast<unsigned char>(str[j]); };
+
+        const auto lead = byte(i);
+        std::size_t length = lead >= 0xF0 && lead <= 0xF4 ? 4 : lead >= 0xE0 && lead <= 0xEF ? 3 : lead >= 0xC2 && lead < 0xE0 ? 2 : 0;
+        if(length == 0 || i + length > std::size(str))
+            return 0;
+
+        for(std::size_t j = 1; j < length; ++j)
+        {
+            if((byte(i + j) & 0xC0) != 0x80)
+                return 0;
+        }
+
+        // overlong, surrogate, and out of range encodings
+        const auto second = byte(i + 1);
+        if((lead == 0xE0 && second < 0xA0) || (lead == 0xED && second >= 0xA0) || (lead == 0xF0 && second < 0x90) || (lead == 0xF4 && second >= 0x90))
+            return 0;
+
+        return length;
+    }
+
+    // names come from filenames, which may not be UTF-8. Valid UTF-8 is copied through, and any other byte is escaped on its own
+    std::string json_string(const std::string & str)
+    {
+        std::ostringstream out;
+        out<<'"';
+        for(std::size_t i = 0; i < std::size(str); ++i)
+        {
+            auto c = str[i];
+            switch(c)
+            {
+            case '"':  out<<"\\\""; break;
+            case '\\': out<<"\\\\"; break;
+            case '\n': out<<"\\n"; break;
+            case '\r': out<<"\\r"; break;
+            case '\t': out<<"\\t"; break;
+            default:
+                if(static_cast<unsigned char>(c) >= 0x80)
+                {
+                    if(auto length = utf8_length(str, i); length > 0)
+                    {
+                        out<<str.substr(i, length);
+                        i += length - 1;
+                    }
+                    else
+                        out<<"\\u"<<std::hex<<std::setw(4)<<std::setfill('0')<<static_cast<int>(static_cast<unsigned char>(c))<<std::dec<<std::setfill(' ');
+                }
+                else if(static_cast<unsigned char>(c) < 0x20)
+                    out<<"\\u"<<std::hex<<std::setw(4)<<std::setfill('0')<<static_cast<int>(c)<<std::dec<<std::setfill(' ');
+                else
+                    out<<c;
+            }
+        }
+        out<<'"';
+        return out.str();
+    }
+
+    double ratio(std::uint64_t compressed, std::uint64_t raw)
+    {
+        return raw ? static_cast<double>(compressed) / raw : 0.0;
+    }
+}
+
+void print_stats(std::ostream & out, const std::vector<Logo_stats> & stats)
+{
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    for(auto && logo: stats)
+    {
+        out<<std::fixed<<std::setprecision(3)
+            <<logo.filename<<": "<<logo.file_size<<" bytes, "<<std::size(logo.entries)<<" images, "
+            <<logo.padding<<" bytes padding. read "<<logo.read_seconds * 1000.0<<" ms, directory "<<logo.parse_seconds * 1000.0<<" ms";
+        if(logo.write_seconds > 0.0)
+            out<<", write "<<logo.write_seconds * 1000.0<<" ms";
+        out<<'\n';
+
+        out<<std::left<<"  "<<std::setw(24)<<"name"<<std::right
+            <<std::setw(11)<<"size"
+            <<std::setw(12)<<"compressed"
+            <<std::setw(7)<<"ratio"
+            <<std::setw(9)<<"repeat"
+            <<std::setw(9)<<"literal"
+            <<std::setw(9)<<"avg run"
+            <<std::setw(9)<<"padding"
+            <<std::setw(10)<<"rle ms"
+            <<std::setw(10)<<"image ms"
+            <<std::setw(10)<<"cache ms"
+            <<std::setw(10)<<"write ms"
+            <<'\n';
+
+        Entry_stats total;
+        for(auto && entry: logo.entries)
+        {
+            auto size = std::to_string(entry.width) + "x" + std::to_string(entry.height);
+            out<<std::left<<"  "<<std::setw(24)<<entry.name<<std::right
+                <<std::setw(11)<<size
+                <<std::setw(12)<<entry.compressed_size
+                <<std::setw(7)<<std::setprecision(3)<<ratio(entry.compressed_size, entry.raw_size)
+                <<std::setw(9)<<entry.rle.repeat_packets
+                <<std::setw(9)<<entry.rle.literal_packets
+                <<std::setw(9)<<std::setprecision(1)<<entry.rle.average_run()
+                <<std::setw(9)<<entry.padding
+                <<std::setprecision(3)
+                <<std::setw(10)<<entry.rle_seconds * 1000.0
+                <<std::setw(10)<<entry.image_seconds * 1000.0
+                <<std::setw(10)<<entry.cache_seconds * 1000.0
+                <<std::setw(10)<<entry.write_seconds * 1000.0;
+            if(entry.kept)
+                out<<" (kept)";
+            else if(entry.shared)
+                out<<" (shared)";
+            else if(entry.cached)
+                out<<" (cached)";
+            out<<'\n';
+
+            total.raw_size += entry.raw_size;
+            if(!entry.shared) // stored once, by the entry it's shared with
+                total.compressed_size += entry.compressed_size;
+            total.padding += entry.padding;
+            total.rle.repeat_packets += entry.rle.repeat_packets;
+            total.rle.literal_packets += entry.rle.literal_packets;
+            total.rle.repeat_pixels += entry.rle.repeat_pixels;
+            total.rle.literal_pixels += entry.rle.literal_pixels;
+            total.rle_seconds += entry.rle_seconds;
+            total.image_seconds += entry.image_seconds;
+            total.cache_seconds += entry.cache_seconds;
+            total.write_seconds += entry.write_seconds;
+        }
+
+        out<<std::left<<"  "<<std::setw(24)<<"total"<<std::right
+            <<std::setw(11)<<""
+            <<std::setw(12)<<total.compressed_size
+            <<std::setw(7)<<std::setprecision(3)<<ratio(total.compressed_size, total.raw_size)
+            <<std::setw(9)<<total.rle.repeat_packets
+            <<std::setw(9)<<total.rle.literal_packets
+            <<std::setw(9)<<std::setprecision(1)<<total.rle.average_run()
+            <<std::setw(9)<<total.padding
+            <<std::setprecision(3)
+            <<std::setw(10)<<total.rle_seconds * 1000.0
+            <<std::setw(10)<<total.image_seconds * 1000.0
+            <<std::setw(10)<<total.cache_seconds * 1000.0
+            <<std::setw(10)<<total.write_seconds * 1000.0
+            <<'\n';
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void print_stats_json(std::ostream & out, const std::vector<Logo_stats> & stats)
+{
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    out<<"[\n";
+    for(auto i = 0u; i < std::size(stats); ++i)
+    {
+        auto && logo = stats[i];
+        out<<"  {\"file\": "<<json_string(logo.filename)
+            <<", \"file_size\": "<<logo.file_size
+            <<", \"padding_bytes\": "<<logo.padding
+            <<std::scientific<<std::setprecision(6)
+            <<", \"read_seconds\": "<<logo.read_seconds
+            <<", \"parse_seconds\": "<<logo.parse_seconds
+            <<", \"write_seconds\": "<<logo.write_seconds
+            <<", \"entries\": [\n";
+
+        for(auto j = 0u; j < std::size(logo.entries); ++j)
+        {
+            auto && entry = logo.entries[j];
+            out<<"    {\"name\": "<<json_string(entry.name)
+                <<", \"width\": "<<entry.width
+                <<", \"height\": "<<entry.height
+                <<", \"raw_bytes\": "<<entry.raw_size
+                <<", \"compressed_bytes\": "<<entry.compressed_size
+                <<", \"padding_bytes\": "<<entry.padding
+                <<", \"repeat_packets\": "<<entry.rle.repeat_packets
+                <<", \"literal_packets\": "<<entry.rle.literal_packets
+                <<", \"repeat_pixels\": "<<entry.rle.repeat_pixels
+                <<", \"literal_pixels\": "<<entry.rle.literal_pixels
+                <<std::fixed<<std::setprecision(3)
+                <<", \"average_run\": "<<entry.rle.average_run()
+                <<std::scientific<<std::setprecision(6)
+                <<", \"image_seconds\": "<<entry.image_seconds
+                <<", \"rle_seconds\": "<<entry.rle_seconds
+                <<", \"cache_seconds\": "<<entry.cache_seconds
+                <<", \"write_seconds\": "<<entry.write_seconds
+                <<", \"kept\": "<<(entry.kept ? "true" : "false")
+                <<", \"cached\": "<<(entry.cached ? "true" : "false")
+                <<", \"shared\": "<<(entry.shared ? "true" : "false")
+                <<"}"<<(j + 1 < std::size(logo.entries) ? "," : "")<<'\n';
+        }
+
+        out<<"  ]}"<<(i + 1 < std::size(stats) ? "," : "")<<'\n';
+    }
+    out<<"]\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void write_stats_json(const std::string & filename, const std::vector<Logo_stats> & stats)
+{
+    if(filename == "-")
+    {
+        print_stats_json(std::cout, stats);
+        return;
+    }
+
+    std::ofstream out{filename};
+    if(!out)
+        throw std::runtime_error{"Could not open output file: " + filename + ". " + std::strerror(errno)};
+
+    print_stats_json(out, stats);
+
+    out.close();
+    if(!out)
+        throw std::runtime_error{"Error writing " + filename + ". " + std::strerror(errno)};
+}
@@ -0,0 +1,71 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+// RLE packet counts for one MotoRun image
+struct Rle_stats
+{
+    std::uint64_t repeat_packets {0};
+    std::uint64_t literal_packets {0};
+    std::uint64_t repeat_pixels {0};
+    std::uint64_t literal_pixels {0};
+
+    // mean number of pixels covered by a repeat packet
+    double average_run() const { return repeat_packets ? static_cast<double>(repeat_pixels) / repeat_packets : 0.0; }
+};
+
+// statistics for one image, filled in by read_logo and write_logo when requested. Times are in seconds
+struct Entry_stats
+{
+    std::string name;
+    std::size_t width {0};
+    std::size_t height {0};
+    std::uint64_t raw_size {0}; // 3 bytes per pixel
+    std::uint64_t compressed_size {0};
+    std::uint64_t padding {0}; // 0xFF bytes after this image, aligning the next one to 512 bytes
+    Rle_stats rle;
+
+    double image_seconds {0.0}; // reading or writing the PNG (or other format) file
+    double rle_seconds {0.0}; // RLE encoding or decoding
+    double cache_seconds {0.0}; // hashing and looking up the compressed image cache
+    double write_seconds {0.0}; // writing the compressed image into the logo.bin file
+
+    bool kept {false}; // copied from an existing logo.bin without re-encoding
+    bool cached {false}; // found in the cache without re-encoding
+    bool shared {false}; // identical to an earlier image, whose data it points to instead of storing another copy
+};
+
+// statistics for one logo.bin file
+struct Logo_stats
+{
+    std::string filename;
+    std::uint64_t file_size {0};
+    std::uint64_t padding {0}; // all alignment padding, including between the directory and the first image
+
+    double read_seconds {0.0}; // opening and mapping the logo.bin file (or the --update file when packing)
+    double parse_seconds {0.0}; // reading its directory
+    double write_seconds {0.0}; // writing the directory, and finishing the output file
+
+    std::vector<Entry_stats> entries;
+};
+
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// human readable table, one section per file
+void print_stats(std::ostream & out, const std::vector<Logo_stats> & stats);
+// array of objects, one per file
+void print_stats_json(std::ostream & out, const std::vector<Logo_stats> & stats);
+// print_stats_json to a file, or stdout when filename is "-"
+void write_stats_json(const std::string & filename, const std::vector<Logo_stats> & stats);
+
+#endif // STATS_HPP
@@ -0,0 +1,81 @@
+#include "synthetic.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <stdexcept>
+
+#include <cmath>
+
+const std::vector<Synthetic_profile> & synthetic_profiles()
+{
+    static const std::vector<Synthetic_profile> profiles
+    {
+        {"flat",     400.0, 0.0,  4},
+        {"text",       4.0, 0.0,  2},
+        {"gradient",   2.0, 0.02, 256},
+        {"noise",      1.0, 1.0,  2},
+    };
+    return profiles;
+}
+
+const std::vector<Synthetic_resolution> & synthetic_resolutions()
+{
+    static const std::vector<Synthetic_resolution> resolutions
+    {
+        {"720p",  720,  1280},
+        {"1080p", 1080, 1920},
+        {"1440p", 1440, 2560},
+    };
+    return resolutions;
+}
+
+Image make_synthetic_image(const Synthetic_params & params)
+{
+    if(!(params.mean_run >= 1.0) || !std::isfinite(params.mean_run))
+        throw std::runtime_error{"Mean run length must be at least 1"};
+    if(params.noise < 0.0 || params.noise > 1.0)
+        throw std::runtime_error{"Noise must be between 0 and 1"};
+    if(params.palette == 0)
+        throw std::runtime_error{"Palette must have at least 1 color"};
+
+    std::mt19937 rng{params.seed};
+
+    std::vector<std::uint32_t> palette(params.palette);
+    for(auto && c: palette)
+        c = rng() & 0xFFFFFFu;
+
+    // geometric distribution, shifted so every run is at least one pixel.
+    // It needs 0 < p < 1, so a mean of 1 is handled separately: every run is a single pixel
+    auto run_length = std::optional<std::geometric_distribution<std::size_t>>{};
+    if(params.mean_run > 1.0)
+        run_length.emplace(1.0 / params.mean_run);
+    std::uniform_int_distribution<std::size_t> pick_color{0, std::size(palette) - 1};
+    std::bernoulli_distribution is_noise{params.noise};
+
+    Image im{params.width, params.height};
+
+    auto px = std::begin(im.image_data);
+    auto set_pixel = [&px](std::uint32_t c)
+    {
+        *px++ = static_cast<std::uint8_t>(c >> 16);
+        *px++ = static_cast<std::uint8_t>(c >> 8);
+        *px++ = static_cast<std::uint8_t>(c);
+    };
+
+    for(std::size_t row = 0; row < params.height; ++row)
+    {
+        for(std::size_t col = 0; col < params.width;)
+        {
+            auto color = palette[pick_color(rng)];
+            auto count = std::min((run_length ? (*run_length)(rng) : 0u) + 1, params.width - col);
+
+            for(auto i = 0u; i < count; ++i)
+                set_pixel(params.noise > 0.0 && is_noise(rng) ? rng() & 0xFFFFFFu : color);
+
+            col += count;
+        }
+    }
+
+    return im;
+}
@@ -0,0 +1,47 @@
+#ifndef SYNTHETIC_HPP
+#define SYNTHETIC_HPP
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "image.hpp"
+
+// parameters for generating test images that look like boot logos to the RLE encoder
+struct Synthetic_params
+{
+    std::size_t width {720};
+    std::size_t height {1280};
+    double mean_run {64.0};    // average length of a run of one color, in pixels. Runs don't cross rows
+    double noise {0.0};        // chance of any pixel being replaced with a random color, 0 - 1
+    unsigned int palette {8};  // number of distinct colors used for runs
+    std::uint32_t seed {1};
+};
+
+// named run length profiles
+struct Synthetic_profile
+{
+    std::string name;
+    double mean_run;
+    double noise;
+    unsigned int palette;
+};
+
+// flat: mostly solid color, like a plain background. text: runs of a few pixels, like text or line art.
+// gradient: many colors, short runs. noise: random pixels, the worst case for RLE
+const std::vector<Synthetic_profile> & synthetic_profiles();
+
+// standard phone screen sizes, portrait
+struct Synthetic_resolution
+{
+    std::string name;
+    std::size_t width;
+    std::size_t height;
+};
+const std::vector<Synthetic_resolution> & synthetic_resolutions();
+
+Image make_synthetic_image(const Synthetic_params & params);
+
+#endif // SYNTHETIC_HPP